@@ -1,88 +1,406 @@
 #include "aggregators.h"
+
+#include <cmath>
+#include <numbers>
+
 #include "absl/strings/str_format.h"
+#include "base.h"
+#include "varint.h"
 
-namespace {
+CountDistinctAggregator::CountDistinctAggregator(
+    const CountDistinctAggregator& other)
+    : column_(other.column_),
+      expr_(other.expr_),
+      next_group_(other.next_group_) {
+  // Values are added in the same order, so states of `other` stay valid.
+  for (const Value& value : other.values_) {
+    std::string_view key = KeyArena::Load(value.data);
+    const char* data = arena_.Store(key);
+    set_.insert(ArenaKey{data, HashedKey::Hash(key)});
+    values_.push_back({data, value.prev});
+  }
+}
 
-template <class T>
-bool UpdateMin(T& min, T v) {
-  if (v < min) {
-    min = v;
-    return true;
-  } else {
-    return false;
+CountDistinctAggregator::State CountDistinctAggregator::NewGroup() {
+  if (next_group_ == std::numeric_limits<uint32_t>::max()) {
+    Fail("Too many groups for count(distinct)");
   }
+  return {.count = 0, .last = 0, .group = next_group_++};
 }
 
-template <class T>
-bool UpdateMax(T& max, T v) {
-  if (v > max) {
-    max = v;
-    return true;
-  } else {
-    return false;
+void CountDistinctAggregator::Add(State& state, std::string_view value) {
+  buf_.clear();
+  AppendVarint32(state.group, &buf_);
+  buf_.append(value);
+  HashedKey key(buf_);
+  set_.lazy_emplace(key, [&](const auto& ctor) {
+    const char* data = arena_.Store(buf_);
+    values_.push_back({data, state.last});
+    state.last = values_.size();
+    ++state.count;
+    ctor(ArenaKey{data, key.hash});
+  });
+}
+
+void CountDistinctAggregator::Print(const State& state,
+                                    OutputTable& out) const {
+  out.SetNumber(column_, Numeric(state.count));
+}
+
+void CountDistinctAggregator::Reset() {
+  next_group_ = 0;
+  decltype(set_)().swap(set_);
+  arena_ = KeyArena();
+  decltype(values_)().swap(values_);
+  decltype(buf_)().swap(buf_);
+}
+
+void CountDistinctAggregator::Save(const State& state,
+                                   std::string* out) const {
+  out->append(reinterpret_cast<const char*>(&state.count),
+              sizeof(state.count));
+  ForEachValue(state, [&](std::string_view value) {
+    AppendVarint32(value.size(), out);
+    out->append(value);
+  });
+}
+
+CountDistinctAggregator::State CountDistinctAggregator::Load(const char*& p) {
+  int64_t count;
+  memcpy(&count, p, sizeof(count));
+  p += sizeof(count);
+  State state = NewGroup();
+  for (int64_t i = 0; i < count; ++i) {
+    uint32_t len = ParseVarint32(p);
+    Add(state, std::string_view(p, len));
+    p += len;
   }
+  return state;
 }
 
-template <class V>
-inline bool SumOverflows(V a, V b) {
-  return (a > 0 && b > std::numeric_limits<V>::max() - a) ||
-         (a < 0 && b > std::numeric_limits<V>::lowest() - a);
+size_t CountDistinctAggregator::MemoryUsage() const {
+  return set_.capacity() * (sizeof(ArenaKey) + 1) + arena_.MemoryUsage() +
+         values_.capacity() * sizeof(Value);
 }
 
-inline double AsDouble(std::variant<int64_t, double> n) {
-  return std::visit([](auto v) { return static_cast<double>(v); }, n);
+namespace {
+
+// Quantile `q` of a distribution summarized by `centroids`, sorted by mean,
+// and its extremes. Every centroid stands for values spread evenly around
+// its mean, half of its weight on either side, except that single values
+// are exact. Follows MergingDigest.quantile() of the reference t-digest.
+template <class Centroid>
+double QuantileOf(const std::vector<Centroid>& centroids, double min,
+                  double max, double q) {
+  double total = 0;
+  for (const Centroid& c : centroids) total += c.weight;
+  double index = q * total;
+  const Centroid& first = centroids.front();
+  const Centroid& last = centroids.back();
+  if (index < 1) return min;
+  if (first.weight > 1 && index < first.weight / 2) {
+    return min + (index - 1) / (first.weight / 2 - 1) * (first.mean - min);
+  }
+  if (index > total - 1) return max;
+  if (last.weight > 1 && total - index < last.weight / 2) {
+    return max - (total - index - 1) / (last.weight / 2 - 1) *
+                     (max - last.mean);
+  }
+
+  double so_far = first.weight / 2;
+  for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+    const Centroid& left = centroids[i];
+    const Centroid& right = centroids[i + 1];
+    double dw = (left.weight + right.weight) / 2;
+    if (so_far + dw > index) {
+      double left_unit = 0;
+      if (left.weight == 1) {
+        if (index - so_far < 0.5) return left.mean;
+        left_unit = 0.5;
+      }
+      double right_unit = 0;
+      if (right.weight == 1) {
+        if (so_far + dw - index <= 0.5) return right.mean;
+        right_unit = 0.5;
+      }
+      double z1 = index - so_far - left_unit;
+      double z2 = so_far + dw - index - right_unit;
+      return (left.mean * z2 + right.mean * z1) / (z1 + z2);
+    }
+    so_far += dw;
+  }
+  // Past the middle of the last centroid.
+  double z1 = index - so_far;
+  double z2 = total - index;
+  return (last.mean * z2 + max * z1) / (z1 + z2);
 }
 
 }  // namespace
 
-Numeric Numeric::Make(FieldValue field) {
-  std::string_view f = field;
-  if (std::any_of(f.begin(), f.end(),
-                  [](char c) { return c == '.' || c == 'e' || c == 'E'; })) {
-    return Numeric(ParseAs<double>(field));
+QuantileAggregator::State QuantileAggregator::Copy(
+    const QuantileAggregator& from, const State& s) {
+  State state = {.min = s.min, .max = s.max, .digest = 0};
+  if (s.digest != 0) {
+    NewDigest(state);
+    std::vector<Centroid>& centroids = Centroids(state);
+    centroids = from.Centroids(s);
+    centroids_memory_ += centroids.capacity() * sizeof(Centroid);
+  }
+  return state;
+}
+
+void QuantileAggregator::Merge(const QuantileAggregator& from,
+                               const State& s, State& state) {
+  Expand(state);
+  if (s.digest == 0) {
+    Append(state, {.mean = s.min, .weight = 1});
   } else {
-    return Numeric(ParseAs<int64_t>(field));
+    // Looked up every time, as `from` may be this aggregator, whose digests
+    // move as they are added.
+    for (size_t i = 0; i < from.Centroids(s).size(); ++i) {
+      Append(state, from.Centroids(s)[i]);
+    }
   }
+  state.min = std::min(state.min, s.min);
+  state.max = std::max(state.max, s.max);
 }
 
-void Numeric::Add(Numeric field) {
-  if (int64_t* current = std::get_if<int64_t>(&v_)) {
-    if (int64_t* that = std::get_if<int64_t>(&field.v_)) {
-      if (!SumOverflows(*current, *that)) {
-        *current += *that;
-        return;
-      }
+void QuantileAggregator::NewDigest(State& state) {
+  if (digests_.size() == std::numeric_limits<uint32_t>::max()) {
+    Fail("Too many groups for quantile()");
+  }
+  digests_.emplace_back();
+  state.digest = digests_.size();
+}
+
+void QuantileAggregator::Append(State& state, Centroid c) {
+  std::vector<Centroid>& centroids = Centroids(state);
+  size_t capacity = centroids.capacity();
+  centroids.push_back(c);
+  centroids_memory_ += (centroids.capacity() - capacity) * sizeof(Centroid);
+  if (centroids.size() == kMaxCentroids) Compress(centroids);
+}
+
+void QuantileAggregator::Compress(std::vector<Centroid>& centroids) {
+  std::sort(centroids.begin(), centroids.end(),
+            [](const Centroid& a, const Centroid& b) {
+              return a.mean < b.mean;
+            });
+  double total = 0;
+  for (const Centroid& c : centroids) total += c.weight;
+
+  // Weight up to which the centroid which starts at weight `so_far` may
+  // grow: one unit further on the k1 scale, in which a unit is a smaller
+  // share of all values near either end.
+  constexpr double kStep = 2 * std::numbers::pi / kCompression;
+  auto limit = [&](double so_far) {
+    double k = std::asin(2 * so_far / total - 1) + kStep;
+    return k >= std::numbers::pi / 2 ? total : total * (std::sin(k) + 1) / 2;
+  };
+
+  scratch_.clear();
+  double so_far = 0;
+  Centroid current = centroids[0];
+  double current_limit = limit(so_far);
+  for (size_t i = 1; i < centroids.size(); ++i) {
+    const Centroid& c = centroids[i];
+    if (so_far + current.weight + c.weight <= current_limit) {
+      current.weight += c.weight;
+      current.mean += (c.mean - current.mean) * c.weight / current.weight;
+    } else {
+      so_far += current.weight;
+      scratch_.push_back(current);
+      current_limit = limit(so_far);
+      current = c;
     }
-    v_ = static_cast<double>(*current);
   }
-  std::get<double>(v_) += AsDouble(field.v_);
+  scratch_.push_back(current);
+  centroids.assign(scratch_.begin(), scratch_.end());
+}
+
+const std::vector<QuantileAggregator::Centroid>& QuantileAggregator::Sorted(
+    const State& state) const {
+  scratch_ = Centroids(state);
+  std::sort(scratch_.begin(), scratch_.end(),
+            [](const Centroid& a, const Centroid& b) {
+              return a.mean < b.mean;
+            });
+  return scratch_;
+}
+
+double QuantileAggregator::Quantile(const State& state, double q) const {
+  if (state.digest == 0) return state.min;
+  return QuantileOf(Sorted(state), state.min, state.max, q);
+}
+
+void QuantileAggregator::Print(const State& state, OutputTable& out) const {
+  const std::vector<Centroid>* sorted =
+      state.digest == 0 ? nullptr : &Sorted(state);
+  for (size_t i = 0; i < quantiles_.size(); ++i) {
+    double value =
+        sorted == nullptr
+            ? state.min
+            : QuantileOf(*sorted, state.min, state.max, quantiles_[i]);
+    out.SetNumber(column_ + i, Numeric(value));
+  }
+}
+
+void QuantileAggregator::Reset() {
+  decltype(digests_)().swap(digests_);
+  centroids_memory_ = 0;
+  decltype(scratch_)().swap(scratch_);
+}
+
+void QuantileAggregator::Save(const State& state, std::string* out) const {
+  out->append(reinterpret_cast<const char*>(&state.min), sizeof(state.min));
+  out->append(reinterpret_cast<const char*>(&state.max), sizeof(state.max));
+  uint32_t size = state.digest == 0 ? 0 : Centroids(state).size();
+  out->append(reinterpret_cast<const char*>(&size), sizeof(size));
+  if (size != 0) {
+    out->append(reinterpret_cast<const char*>(Centroids(state).data()),
+                size * sizeof(Centroid));
+  }
+}
+
+QuantileAggregator::State QuantileAggregator::Load(const char*& p) {
+  State state = {.digest = 0};
+  memcpy(&state.min, p, sizeof(state.min));
+  p += sizeof(state.min);
+  memcpy(&state.max, p, sizeof(state.max));
+  p += sizeof(state.max);
+  uint32_t size;
+  memcpy(&size, p, sizeof(size));
+  p += sizeof(size);
+  if (size != 0) {
+    NewDigest(state);
+    std::vector<Centroid>& centroids = Centroids(state);
+    centroids.resize(size);
+    memcpy(centroids.data(), p, size * sizeof(Centroid));
+    p += size * sizeof(Centroid);
+    centroids_memory_ += centroids.capacity() * sizeof(Centroid);
+  }
+  return state;
+}
+
+size_t QuantileAggregator::MemoryUsage() const {
+  return digests_.capacity() * sizeof(digests_[0]) + centroids_memory_;
 }
 
-bool Numeric::Min(Numeric field) {
-  if (int64_t* current = std::get_if<int64_t>(&v_)) {
-    if (int64_t* that = std::get_if<int64_t>(&field.v_)) {
-      return UpdateMin(*current, *that);
+uint64_t HistogramAggregator::LowerBound(uint32_t bucket) const {
+  if (bucket < uint32_t{1} << precision_) return bucket;
+  uint32_t shift = (bucket >> (precision_ - 1)) - 1;
+  return uint64_t{bucket - (shift << (precision_ - 1))} << shift;
+}
+
+void HistogramAggregator::Grow(State& state, uint32_t bucket,
+                               uint64_t count) {
+  if (state.handle == 0) {
+    if (counters_.size() == std::numeric_limits<uint32_t>::max()) {
+      Fail("Too many groups for hist()");
     }
-    v_ = static_cast<double>(*current);
+    // Add() has counted the new values already.
+    counters_.emplace_back(1, state.count - count);
+    counters_memory_ += counters_.back().capacity() * sizeof(uint64_t);
+    state.handle = counters_.size();
   }
-  return UpdateMin(std::get<double>(v_), AsDouble(field.v_));
+  std::vector<uint64_t>& counters = counters_[state.handle - 1];
+  size_t capacity = counters.capacity();
+  // Growing at least twice as big keeps the number of reallocations down
+  // while a group's range widens.
+  if (bucket < state.first) {
+    uint32_t grow = std::min<size_t>(
+        std::max<size_t>(state.first - bucket, counters.size()),
+        state.first);
+    counters.insert(counters.begin(), grow, 0);
+    state.first -= grow;
+  } else {
+    counters.resize(
+        std::max<size_t>(bucket - state.first + 1, 2 * counters.size()));
+  }
+  counters[bucket - state.first] += count;
+  counters_memory_ += (counters.capacity() - capacity) * sizeof(uint64_t);
 }
 
-bool Numeric::Max(Numeric field) {
-  if (int64_t* current = std::get_if<int64_t>(&v_)) {
-    if (int64_t* that = std::get_if<int64_t>(&field.v_)) {
-      return UpdateMax(*current, *that);
+HistogramAggregator::State HistogramAggregator::Copy(
+    const HistogramAggregator& from, const State& s) {
+  State state = {.first = s.first, .handle = 0, .count = s.count};
+  if (s.handle != 0) {
+    std::vector<uint64_t> counters = from.counters_[s.handle - 1];
+    counters_memory_ += counters.capacity() * sizeof(uint64_t);
+    counters_.push_back(std::move(counters));
+    state.handle = counters_.size();
+  }
+  return state;
+}
+
+void HistogramAggregator::Merge(const HistogramAggregator& from,
+                                const State& s, State& state) {
+  if (s.handle == 0) return Add(state, s.first, s.count);
+  // Looked up every time, as `from` may be this aggregator, whose counters
+  // move as they are added.
+  for (size_t i = 0; i < from.counters_[s.handle - 1].size(); ++i) {
+    uint64_t count = from.counters_[s.handle - 1][i];
+    if (count != 0) Add(state, s.first + i, count);
+  }
+}
+
+void HistogramAggregator::Print(const State& state, OutputTable& out) const {
+  buf_.clear();
+  uint64_t so_far = 0;
+  ForEachBucket(state, [&](uint32_t bucket, uint64_t count) {
+    if (!buf_.empty()) buf_.push_back(',');
+    if (cumulative_) {
+      so_far += count;
+      absl::StrAppendFormat(&buf_, "%d:%.4g", LowerBound(bucket),
+                            100.0 * so_far / state.count);
+    } else {
+      absl::StrAppend(&buf_, LowerBound(bucket), ":", count);
     }
-    v_ = static_cast<double>(*current);
+  });
+  out.Set(column_, buf_);
+}
+
+void HistogramAggregator::Reset() {
+  decltype(counters_)().swap(counters_);
+  counters_memory_ = 0;
+  decltype(buf_)().swap(buf_);
+}
+
+void HistogramAggregator::Save(const State& state, std::string* out) const {
+  out->append(reinterpret_cast<const char*>(&state.first),
+              sizeof(state.first));
+  out->append(reinterpret_cast<const char*>(&state.count),
+              sizeof(state.count));
+  uint32_t size =
+      state.handle == 0 ? 0 : counters_[state.handle - 1].size();
+  out->append(reinterpret_cast<const char*>(&size), sizeof(size));
+  if (size != 0) {
+    out->append(
+        reinterpret_cast<const char*>(counters_[state.handle - 1].data()),
+        size * sizeof(uint64_t));
+  }
+}
+
+HistogramAggregator::State HistogramAggregator::Load(const char*& p) {
+  State state = {.handle = 0};
+  memcpy(&state.first, p, sizeof(state.first));
+  p += sizeof(state.first);
+  memcpy(&state.count, p, sizeof(state.count));
+  p += sizeof(state.count);
+  uint32_t size;
+  memcpy(&size, p, sizeof(size));
+  p += sizeof(size);
+  if (size != 0) {
+    std::vector<uint64_t> counters(size);
+    memcpy(counters.data(), p, size * sizeof(uint64_t));
+    p += size * sizeof(uint64_t);
+    counters_memory_ += counters.capacity() * sizeof(uint64_t);
+    counters_.push_back(std::move(counters));
+    state.handle = counters_.size();
   }
-  return UpdateMax(std::get<double>(v_), AsDouble(field.v_));
+  return state;
 }
 
-void Numeric::Print(std::string* out) const {
-  struct {
-    void operator()(int64_t v) { absl::StrAppend(out, v); }
-    void operator()(double v) { absl::StrAppendFormat(out, "%.8g", v); }
-    std::string* out;
-  } p{out};
-  std::visit(p, v_);
+size_t HistogramAggregator::MemoryUsage() const {
+  return counters_.capacity() * sizeof(counters_[0]) + counters_memory_;
 }
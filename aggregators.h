@@ -1,46 +1,323 @@
 #ifndef GITHUB_ZISZIS_ZG_AGGREGATORS_INCLUDED
 #define GITHUB_ZISZIS_ZG_AGGREGATORS_INCLUDED
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
 #include <limits>
+#include <string>
 #include <variant>
+#include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "expr.h"
+#include "hashed-key.h"
+#include "key-arena.h"
 #include "output.h"
 #include "storage.h"
 #include "types.h"
 
+// Aggregates nothing, for tables which only collect distinct keys.
+class NoAggregator {
+ public:
+  struct State {};
+  State Init(const InputRow&) const { return {}; }
+  void Update(const InputRow&, State&) const {}
+  State Copy(const NoAggregator&, State) const { return {}; }
+  void Merge(const NoAggregator&, State, State&) const {}
+  void Print(State, OutputTable&) const {}
+  void Reset() const {}
+  void Save(State, std::string*) const {}
+  State Load(const char*&) const { return {}; }
+  size_t MemoryUsage() const { return 0; }
+};
+
 class CountAggregator {
  public:
   explicit CountAggregator(int column) : column_(column) {}
   using State = int64_t;
   State Init(const InputRow&) const { return 1; }
   void Update(const InputRow&, State& state) const { ++state; }
+  State Copy(const CountAggregator&, State from) const { return from; }
+  void Merge(const CountAggregator&, State from, State& state) const {
+    state += from;
+  }
   void Print(State state, OutputTable& out) const {
-    buf_.clear();
-    absl::StrAppend(&buf_, state);
-    out.Set(column_, buf_);
+    out.SetNumber(column_, Numeric(state));
+  }
+  void Reset() const {}
+  void Save(State state, std::string* out) const {
+    out->append(reinterpret_cast<const char*>(&state), sizeof(state));
   }
-  void Reset() const { decltype(buf_)().swap(buf_); }
+  State Load(const char*& p) const {
+    State state;
+    memcpy(&state, p, sizeof(state));
+    p += sizeof(state);
+    return state;
+  }
+  size_t MemoryUsage() const { return 0; }
 
  private:
   int column_;
+};
+
+// Exact number of distinct values in a group. Values of all groups live in
+// one hash set of (group id, value) pairs, so a state is a group id and a
+// count, and owns nothing. Values of a group are chained together in the
+// order they were added, for Copy(), Merge() and Save().
+class CountDistinctAggregator {
+ public:
+  struct State {
+    int64_t count;
+    // 1 + index of the group's last value in values_, 0 if none.
+    uint64_t last;
+    uint32_t group;
+  };
+
+  CountDistinctAggregator(int column, Expr<std::string_view> expr)
+      : column_(column), expr_(expr) {}
+  CountDistinctAggregator(const CountDistinctAggregator& other);
+  CountDistinctAggregator(CountDistinctAggregator&&) = default;
+
+  State Init(const InputRow& row) {
+    State state = NewGroup();
+    Add(state, expr_.Eval(row));
+    return state;
+  }
+  void Update(const InputRow& row, State& state) {
+    Add(state, expr_.Eval(row));
+  }
+  State Copy(const CountDistinctAggregator& from, const State& s) {
+    State state = NewGroup();
+    Merge(from, s, state);
+    return state;
+  }
+  void Merge(const CountDistinctAggregator& from, const State& s,
+             State& state) {
+    from.ForEachValue(s, [&](std::string_view value) { Add(state, value); });
+  }
+  void Print(const State& state, OutputTable& out) const;
+  void Reset();
+  void Save(const State& state, std::string* out) const;
+  State Load(const char*& p);
+  size_t MemoryUsage() const;
+
+ private:
+  struct Value {
+    // Group id and value, see Add().
+    const char* data;
+    // Previous value of the same group, as in State::last.
+    uint64_t prev;
+  };
+
+  State NewGroup();
+  void Add(State& state, std::string_view value);
+
+  template <class Fn>
+  void ForEachValue(const State& state, Fn fn) const {
+    for (uint64_t i = state.last; i != 0; i = values_[i - 1].prev) {
+      std::string_view key = KeyArena::Load(values_[i - 1].data);
+      const char* p = key.data();
+      ParseVarint32(p);
+      fn(std::string_view(p, key.data() + key.size() - p));
+    }
+  }
+
+  int column_;
+  Expr<std::string_view> expr_;
+  uint32_t next_group_ = 0;
+  absl::flat_hash_set<ArenaKey, HashedKeyHash, HashedKeyEq> set_;
+  KeyArena arena_;
+  std::vector<Value> values_;
   mutable std::string buf_;
 };
 
-class Numeric {
+// Quantiles of a numeric field in a group, estimated with a merging
+// t-digest: values are kept as centroids (mean and weight), which are small
+// near the ends of the distribution and larger in the middle, so the error
+// of extreme quantiles such as p999 is a small fraction of their distance
+// to 0 or 1. A group takes a 24 byte state, the only value of a group with
+// one is its min, and the centroids of larger groups live in the
+// aggregator, each group's bounded by kMaxCentroids (8KB).
+//
+// Prints one column per quantile, starting at `column`.
+class QuantileAggregator {
+ public:
+  struct State {
+    double min;
+    double max;
+    // 1 + index of the group's digest in digests_, 0 if it has one value.
+    uint32_t digest;
+  };
+
+  QuantileAggregator(int column, Expr<Numeric> expr,
+                     std::vector<double> quantiles)
+      : column_(column),
+        expr_(expr),
+        quantiles_(std::move(quantiles)) {}
+
+  State Init(const InputRow& row) {
+    double value = expr_.Eval(row).ToDouble();
+    return {.min = value, .max = value, .digest = 0};
+  }
+  void Update(const InputRow& row, State& state) {
+    double value = expr_.Eval(row).ToDouble();
+    Expand(state);
+    Append(state, {.mean = value, .weight = 1});
+    state.min = std::min(state.min, value);
+    state.max = std::max(state.max, value);
+  }
+  State Copy(const QuantileAggregator& from, const State& s);
+  void Merge(const QuantileAggregator& from, const State& s, State& state);
+  void Print(const State& state, OutputTable& out) const;
+  void Reset();
+  void Save(const State& state, std::string* out) const;
+  State Load(const char*& p);
+  size_t MemoryUsage() const;
+
+  // Estimated quantile `q` (0 <= q <= 1) of the group.
+  double Quantile(const State& state, double q) const;
+
+ private:
+  // Centroids are merged so that one spans at most 1 / kCompression of the
+  // k1 scale (2 / pi * asin(2q - 1)): about kCompression centroids in all.
+  static constexpr double kCompression = 200;
+  // Values and merged digests are appended, and the lot compressed back to
+  // about kCompression centroids once a group has this many.
+  static constexpr size_t kMaxCentroids = 512;
+
+  struct Centroid {
+    double mean;
+    double weight;
+  };
+
+  // Gives a group with one value a digest of its own.
+  void Expand(State& state) {
+    if (state.digest == 0) {
+      NewDigest(state);
+      Append(state, {.mean = state.min, .weight = 1});
+    }
+  }
+  void NewDigest(State& state);
+  void Append(State& state, Centroid c);
+  // Merges centroids into as few as kCompression allows.
+  void Compress(std::vector<Centroid>& centroids);
+  // Centroids of a group with more than one value, sorted, in scratch_.
+  const std::vector<Centroid>& Sorted(const State& state) const;
+  std::vector<Centroid>& Centroids(const State& state) {
+    return digests_[state.digest - 1];
+  }
+  const std::vector<Centroid>& Centroids(const State& state) const {
+    return digests_[state.digest - 1];
+  }
+
+  int column_;
+  Expr<Numeric> expr_;
+  std::vector<double> quantiles_;
+  std::vector<std::vector<Centroid>> digests_;
+  // Bytes taken by the vectors in digests_.
+  size_t centroids_memory_ = 0;
+  mutable std::vector<Centroid> scratch_;
+};
+
+// Distribution of a numeric field in a group, counted in log-linear buckets
+// as in HdrHistogram: values below 2^precision get a bucket each, and every
+// following power of two is split into 2^(precision - 1) buckets, so a
+// bucket is at most 1 / 2^(precision - 1) of its values wide. Values are
+// rounded to integers, negative ones are an error.
+//
+// A group whose values all fall into one bucket only takes its 16 byte
+// state. Others count into an array of the buckets between their lowest and
+// highest values, which lives in the aggregator and only grows when a value
+// falls outside of it, so most updates are an index computation, a range
+// check and an increment.
+//
+// Prints the non-empty buckets as `lower bound:count` pairs separated by
+// commas, or with `cumulative`, as `lower bound:percentage of values up to
+// the bucket`.
+class HistogramAggregator {
  public:
-  static Numeric Make(FieldValue);
+  struct State {
+    // Bucket of the group's first counter.
+    uint32_t first;
+    // 1 + index of the group's counters in counters_, 0 if all values are
+    // in bucket `first`.
+    uint32_t handle;
+    uint64_t count;
+  };
 
-  void Add(Numeric);
-  bool Min(Numeric);
-  bool Max(Numeric);
-  void Print(std::string*) const;
+  HistogramAggregator(int column, Expr<Numeric> expr, int precision,
+                      bool cumulative)
+      : column_(column),
+        expr_(expr),
+        precision_(precision),
+        cumulative_(cumulative) {}
+
+  State Init(const InputRow& row) {
+    return {.first = Bucket(Value(row)), .handle = 0, .count = 1};
+  }
+  void Update(const InputRow& row, State& state) {
+    Add(state, Bucket(Value(row)), 1);
+  }
+  State Copy(const HistogramAggregator& from, const State& s);
+  void Merge(const HistogramAggregator& from, const State& s, State& state);
+  void Print(const State& state, OutputTable& out) const;
+  void Reset();
+  void Save(const State& state, std::string* out) const;
+  State Load(const char*& p);
+  size_t MemoryUsage() const;
+
+  // Bucket of a value, and the lowest value in a bucket.
+  uint32_t Bucket(uint64_t value) const {
+    int width = std::bit_width(value);
+    uint32_t shift = std::max(width - precision_, 0);
+    return (shift << (precision_ - 1)) + (value >> shift);
+  }
+  uint64_t LowerBound(uint32_t bucket) const;
 
  private:
-  explicit Numeric(int64_t v) : v_(v) {}
-  explicit Numeric(double v) : v_(v) {}
-  std::variant<int64_t, double> v_;
+  uint64_t Value(const InputRow& row) const {
+    double value = std::round(expr_.Eval(row).ToDouble());
+    if (value < 0) Fail("hist() of a negative value: ", value);
+    return value;
+  }
+
+  void Add(State& state, uint32_t bucket, uint64_t count) {
+    state.count += count;
+    if (state.handle == 0) {
+      if (bucket == state.first) return;
+    } else {
+      std::vector<uint64_t>& counters = counters_[state.handle - 1];
+      if (bucket - state.first < counters.size()) {
+        counters[bucket - state.first] += count;
+        return;
+      }
+    }
+    Grow(state, bucket, count);
+  }
+  // Makes room for `bucket` in the counters of a group, and counts `count`
+  // values in it.
+  void Grow(State& state, uint32_t bucket, uint64_t count);
+  // Calls fn(bucket, count) for non-empty buckets in increasing order.
+  template <class Fn>
+  void ForEachBucket(const State& state, Fn fn) const {
+    if (state.handle == 0) return fn(state.first, state.count);
+    const std::vector<uint64_t>& counters = counters_[state.handle - 1];
+    for (size_t i = 0; i < counters.size(); ++i) {
+      if (counters[i] != 0) fn(state.first + i, counters[i]);
+    }
+  }
+
+  int column_;
+  Expr<Numeric> expr_;
+  int precision_;
+  bool cumulative_;
+  std::vector<std::vector<uint64_t>> counters_;
+  // Bytes taken by the vectors in counters_.
+  size_t counters_memory_ = 0;
+  mutable std::string buf_;
 };
 
 template<class Value, class R, R(Value::*fn)(Value)>
@@ -53,8 +330,15 @@ class GenericAggregator {
   void Update(const InputRow& row, State& state) const {
     (state.*fn)(expr_.Eval(row));
   }
+  State Copy(const GenericAggregator&, State from) const { return from; }
+  void Merge(const GenericAggregator&, State from, State& state) const {
+    (state.*fn)(from);
+  }
   void Print(State s, OutputTable& out) const { expr_.Print(s, out); }
   void Reset() const { expr_.Reset(); }
+  void Save(State s, std::string* out) const { s.Save(out); }
+  State Load(const char*& p) const { return Value::Load(p); }
+  size_t MemoryUsage() const { return 0; }
 
  private:
   ExprColumn<Value> expr_;
@@ -69,6 +353,9 @@ using MinAggregator = GenericAggregator<Value, bool, &Value::Min>;
 template <class Value>
 using MaxAggregator = GenericAggregator<Value, bool, &Value::Max>;
 
+// Columns of the row with the lowest or highest value in a group. Of rows
+// with the same value, the first one wins: the first one pushed, or the one
+// in the state merged into.
 template <class Value, bool (Value::*fn)(Value)>
 class ArgMAggregator {
  public:
@@ -88,12 +375,36 @@ class ArgMAggregator {
     }
   }
 
+  // Copy() and Merge() take the state from another instance of the same
+  // aggregator, so the arguments have to be moved between storages.
+  State Copy(const ArgMAggregator& from, const State& s) {
+    return {s.first, storage_.Store(from.storage_, s.second)};
+  }
+
+  void Merge(const ArgMAggregator& from, const State& s, State& state) {
+    if ((state.first.*fn)(s.first)) {
+      storage_.Update(state.second, from.storage_, s.second);
+    }
+  }
+
   void Print(const State& s, OutputTable& out) const {
     storage_.Print(s.second, out);
   }
 
   void Reset() { storage_.Reset(); }
 
+  // States saved to disk carry their arguments along, and the storage is
+  // what the aggregator adds to the memory taken by states themselves.
+  void Save(const State& s, std::string* out) const {
+    s.first.Save(out);
+    storage_.Save(s.second, out);
+  }
+  State Load(const char*& p) {
+    Value value = Value::Load(p);
+    return {value, storage_.Load(p)};
+  }
+  size_t MemoryUsage() const { return storage_.MemoryUsage(); }
+
  private:
   Expr<Value> value_;
   MultiColumnDynamicStorage storage_;
@@ -0,0 +1,420 @@
+#include "aggregators.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "gtest/gtest.h"
+#include "multi-aggregation.h"
+#include "varint.h"
+
+namespace {
+
+using State = QuantileAggregator::State;
+
+QuantileAggregator MakeQuantileAggregator() {
+  return QuantileAggregator(0, Expr<Numeric>{.field = 0}, {0.5});
+}
+
+State MakeState(QuantileAggregator& aggregator,
+                const std::vector<double>& values) {
+  InputRow row;
+  std::string value = absl::StrFormat("%.17g", values[0]);
+  row.Reset(value);
+  State state = aggregator.Init(row);
+  for (size_t i = 1; i < values.size(); ++i) {
+    value = absl::StrFormat("%.17g", values[i]);
+    row.Reset(value);
+    aggregator.Update(row, state);
+  }
+  return state;
+}
+
+// Rank of the estimated quantile `q` of `values` (sorted) as a fraction.
+double RankOf(QuantileAggregator& aggregator, const State& state,
+              const std::vector<double>& values, double q) {
+  double estimate = aggregator.Quantile(state, q);
+  return static_cast<double>(std::lower_bound(values.begin(), values.end(),
+                                              estimate) -
+                             values.begin()) /
+         values.size();
+}
+
+std::vector<double> LogNormalValues(size_t n, int seed) {
+  std::mt19937_64 e(seed);
+  std::lognormal_distribution<double> dist(3, 1);
+  std::vector<double> values(n);
+  for (double& v : values) v = static_cast<int64_t>(dist(e) * 1000);
+  return values;
+}
+
+TEST(QuantileAggregator, SmallGroupsAreExact) {
+  QuantileAggregator aggregator = MakeQuantileAggregator();
+  State one = MakeState(aggregator, {7});
+  EXPECT_EQ(aggregator.Quantile(one, 0), 7);
+  EXPECT_EQ(aggregator.Quantile(one, 0.5), 7);
+  EXPECT_EQ(aggregator.Quantile(one, 1), 7);
+
+  State three = MakeState(aggregator, {5, 1, 3});
+  EXPECT_EQ(aggregator.Quantile(three, 0), 1);
+  EXPECT_EQ(aggregator.Quantile(three, 0.5), 3);
+  EXPECT_EQ(aggregator.Quantile(three, 1), 5);
+}
+
+TEST(QuantileAggregator, TailsAreAccurate) {
+  QuantileAggregator aggregator = MakeQuantileAggregator();
+  std::vector<double> values = LogNormalValues(1'000'000, 42);
+  State state = MakeState(aggregator, values);
+  std::sort(values.begin(), values.end());
+  EXPECT_NEAR(RankOf(aggregator, state, values, 0.5), 0.5, 0.01);
+  EXPECT_NEAR(RankOf(aggregator, state, values, 0.99), 0.99, 0.001);
+  EXPECT_NEAR(RankOf(aggregator, state, values, 0.999), 0.999, 0.0002);
+  EXPECT_EQ(aggregator.Quantile(state, 0), values.front());
+  EXPECT_EQ(aggregator.Quantile(state, 1), values.back());
+  // Centroids of a group never take more than kMaxCentroids.
+  EXPECT_LE(aggregator.MemoryUsage(), 512 * 16 + 24);
+}
+
+TEST(QuantileAggregator, Merges) {
+  QuantileAggregator aggregator = MakeQuantileAggregator();
+  QuantileAggregator other = MakeQuantileAggregator();
+  std::vector<double> a = LogNormalValues(100'000, 1);
+  std::vector<double> b = LogNormalValues(300'000, 2);
+  State state = MakeState(aggregator, a);
+  aggregator.Merge(other, MakeState(other, b), state);
+  aggregator.Merge(other, MakeState(other, {1}), state);
+
+  std::vector<double> all = a;
+  all.insert(all.end(), b.begin(), b.end());
+  all.push_back(1);
+  std::sort(all.begin(), all.end());
+  EXPECT_NEAR(RankOf(aggregator, state, all, 0.5), 0.5, 0.01);
+  EXPECT_NEAR(RankOf(aggregator, state, all, 0.99), 0.99, 0.001);
+  EXPECT_EQ(aggregator.Quantile(state, 0), 1);
+
+  State copy = other.Copy(aggregator, state);
+  for (double q : {0.0, 0.1, 0.5, 0.9, 0.999, 1.0}) {
+    EXPECT_EQ(other.Quantile(copy, q), aggregator.Quantile(state, q));
+  }
+}
+
+TEST(QuantileAggregator, SavesAndLoads) {
+  QuantileAggregator aggregator = MakeQuantileAggregator();
+  for (const std::vector<double>& values :
+       {std::vector<double>{3}, std::vector<double>{3, 1.5},
+        LogNormalValues(10'000, 3)}) {
+    State state = MakeState(aggregator, values);
+    std::string saved;
+    aggregator.Save(state, &saved);
+    QuantileAggregator loader = MakeQuantileAggregator();
+    const char* p = saved.data();
+    State loaded = loader.Load(p);
+    EXPECT_EQ(p, saved.data() + saved.size());
+    for (double q : {0.0, 0.5, 0.99, 1.0}) {
+      EXPECT_EQ(loader.Quantile(loaded, q), aggregator.Quantile(state, q));
+    }
+  }
+}
+
+using Distinct = CountDistinctAggregator;
+
+Distinct::State MakeState(Distinct& aggregator,
+                          const std::vector<std::string>& values) {
+  InputRow row;
+  row.Reset(values[0]);
+  Distinct::State state = aggregator.Init(row);
+  for (size_t i = 1; i < values.size(); ++i) {
+    row.Reset(values[i]);
+    aggregator.Update(row, state);
+  }
+  return state;
+}
+
+// Distinct values of a group, sorted, as read back from its saved state.
+std::vector<std::string> ValuesOf(const Distinct& aggregator,
+                                  const Distinct::State& state) {
+  std::string saved;
+  aggregator.Save(state, &saved);
+  const char* p = saved.data() + sizeof(int64_t);
+  std::vector<std::string> values;
+  while (p != saved.data() + saved.size()) {
+    uint32_t len = ParseVarint32(p);
+    values.emplace_back(p, len);
+    p += len;
+  }
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+std::vector<std::string> NumberedValues(int begin, int end) {
+  std::vector<std::string> values;
+  for (int i = begin; i < end; ++i) values.push_back(absl::StrCat("v", i));
+  return values;
+}
+
+TEST(CountDistinctAggregator, CopiesKeepStates) {
+  Distinct aggregator(0, Expr<std::string_view>{.field = 0});
+  Distinct::State a = MakeState(aggregator, {"x", "y", "x", "z"});
+  Distinct::State b = MakeState(aggregator, {"y", "w"});
+  Distinct copy(aggregator);
+  // Values of the copy live in its own arena.
+  aggregator.Reset();
+  EXPECT_EQ(ValuesOf(copy, a), (std::vector<std::string>{"x", "y", "z"}));
+  EXPECT_EQ(ValuesOf(copy, b), (std::vector<std::string>{"w", "y"}));
+
+  // States of the original keep counting in the copy, and new groups
+  // don't collide with theirs.
+  InputRow row;
+  for (std::string_view value : {"y", "v"}) {
+    row.Reset(value);
+    copy.Update(row, a);
+  }
+  Distinct::State c = MakeState(copy, {"x", "y"});
+  EXPECT_EQ(a.count, 4);
+  EXPECT_EQ(b.count, 2);
+  EXPECT_EQ(c.count, 2);
+  EXPECT_EQ(ValuesOf(copy, a),
+            (std::vector<std::string>{"v", "x", "y", "z"}));
+  EXPECT_EQ(ValuesOf(copy, b), (std::vector<std::string>{"w", "y"}));
+}
+
+TEST(CountDistinctAggregator, Merges) {
+  Distinct aggregator(0, Expr<std::string_view>{.field = 0});
+  Distinct other(0, Expr<std::string_view>{.field = 0});
+  Distinct::State state = MakeState(aggregator, NumberedValues(0, 1000));
+  aggregator.Merge(other, MakeState(other, NumberedValues(500, 1500)), state);
+  EXPECT_EQ(state.count, 1500);
+  std::vector<std::string> expected = NumberedValues(0, 1500);
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(ValuesOf(aggregator, state), expected);
+
+  // Merging groups of the same aggregator adds values while walking them.
+  Distinct::State merged = MakeState(aggregator, {"v0", "w"});
+  aggregator.Merge(aggregator, state, merged);
+  EXPECT_EQ(merged.count, 1501);
+  expected.push_back("w");
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(ValuesOf(aggregator, merged), expected);
+  aggregator.Merge(aggregator, merged, merged);
+  EXPECT_EQ(merged.count, 1501);
+
+  Distinct::State copy = aggregator.Copy(aggregator, merged);
+  EXPECT_EQ(copy.count, 1501);
+  EXPECT_EQ(ValuesOf(aggregator, copy), expected);
+  EXPECT_EQ(state.count, 1500);
+}
+
+TEST(CountDistinctAggregator, SavesAndLoads) {
+  Distinct aggregator(0, Expr<std::string_view>{.field = 0});
+  Distinct loader(0, Expr<std::string_view>{.field = 0});
+  // Loaded groups don't collide with the loader's own.
+  Distinct::State own = MakeState(loader, {"a", "b"});
+  for (const std::vector<std::string>& values :
+       {std::vector<std::string>{"a"}, std::vector<std::string>{"", "a", ""},
+        NumberedValues(0, 1000)}) {
+    Distinct::State state = MakeState(aggregator, values);
+    std::string saved;
+    aggregator.Save(state, &saved);
+    const char* p = saved.data();
+    Distinct::State loaded = loader.Load(p);
+    EXPECT_EQ(p, saved.data() + saved.size());
+    EXPECT_EQ(loaded.count, state.count);
+    EXPECT_EQ(ValuesOf(loader, loaded), ValuesOf(aggregator, state));
+  }
+  EXPECT_EQ(ValuesOf(loader, own), (std::vector<std::string>{"a", "b"}));
+}
+
+// Keeps the first column of the last line printed.
+class LastLineTable : public OutputTable {
+ public:
+  LastLineTable() : OutputTable(1) {}
+  void EndLine() override { line = columns_[0]; }
+  void Finish() override {}
+  std::string line;
+};
+
+std::string PrintHistogram(const std::vector<double>& values,
+                           bool cumulative) {
+  HistogramAggregator aggregator(0, Expr<Numeric>{.field = 0}, 3, cumulative);
+  InputRow row;
+  std::string value = absl::StrFormat("%.17g", values[0]);
+  row.Reset(value);
+  HistogramAggregator::State state = aggregator.Init(row);
+  for (size_t i = 1; i < values.size(); ++i) {
+    value = absl::StrFormat("%.17g", values[i]);
+    row.Reset(value);
+    aggregator.Update(row, state);
+  }
+  LastLineTable out;
+  aggregator.Print(state, out);
+  out.EndLine();
+  return out.line;
+}
+
+TEST(HistogramAggregator, Buckets) {
+  for (int precision : {1, 3, 6, 12}) {
+    HistogramAggregator aggregator(0, Expr<Numeric>{.field = 0}, precision,
+                                   false);
+    std::mt19937_64 e(precision);
+    uint32_t prev = 0;
+    for (uint64_t v = 0; v < 100000; ++v) {
+      uint32_t bucket = aggregator.Bucket(v);
+      EXPECT_TRUE(bucket == prev || bucket == prev + 1) << v;
+      prev = bucket;
+    }
+    for (int i = 0; i < 100000; ++i) {
+      uint64_t v = e() >> (e() % 64);
+      uint64_t lower = aggregator.LowerBound(aggregator.Bucket(v));
+      ASSERT_LE(lower, v);
+      ASSERT_LE(v - lower, lower >> (precision - 1)) << v;
+      ASSERT_EQ(aggregator.Bucket(lower), aggregator.Bucket(v));
+    }
+  }
+}
+
+TEST(HistogramAggregator, Prints) {
+  EXPECT_EQ(PrintHistogram({3}, false), "3:1");
+  EXPECT_EQ(PrintHistogram({3, 3.2}, false), "3:2");
+  // Buckets are 1/4 of their values wide past 8.
+  EXPECT_EQ(PrintHistogram({9, 1, 17, 3, 9, 100, 19, 0}, false),
+            "0:1,1:1,3:1,8:2,16:2,96:1");
+  EXPECT_EQ(PrintHistogram({100, 1, 9, 1}, false), "1:2,8:1,96:1");
+  EXPECT_EQ(PrintHistogram({100, 1, 9, 1}, true), "1:50,8:75,96:100");
+}
+
+TEST(HistogramAggregator, MergesAndSaves) {
+  HistogramAggregator aggregator(0, Expr<Numeric>{.field = 0}, 4, false);
+  HistogramAggregator other(0, Expr<Numeric>{.field = 0}, 4, false);
+  InputRow row;
+  auto make = [&](HistogramAggregator& a, std::vector<int> values) {
+    std::string value = absl::StrCat(values[0]);
+    row.Reset(value);
+    HistogramAggregator::State state = a.Init(row);
+    for (size_t i = 1; i < values.size(); ++i) {
+      value = absl::StrCat(values[i]);
+      row.Reset(value);
+      a.Update(row, state);
+    }
+    return state;
+  };
+  auto print = [](const HistogramAggregator& a,
+                  const HistogramAggregator::State& state) {
+    LastLineTable out;
+    a.Print(state, out);
+    out.EndLine();
+    return out.line;
+  };
+
+  HistogramAggregator::State state = make(aggregator, {5});
+  aggregator.Merge(other, make(other, {5}), state);
+  EXPECT_EQ(print(aggregator, state), "5:2");
+  aggregator.Merge(other, make(other, {1000, 2, 1000}), state);
+  aggregator.Merge(aggregator, make(aggregator, {7}), state);
+  EXPECT_EQ(print(aggregator, state), "2:1,5:2,7:1,960:2");
+
+  HistogramAggregator::State copy = other.Copy(aggregator, state);
+  EXPECT_EQ(print(other, copy), "2:1,5:2,7:1,960:2");
+
+  std::string saved;
+  aggregator.Save(state, &saved);
+  const char* p = saved.data();
+  HistogramAggregator::State loaded = other.Load(p);
+  EXPECT_EQ(p, saved.data() + saved.size());
+  EXPECT_EQ(print(other, loaded), "2:1,5:2,7:1,960:2");
+}
+
+using ArgMax = ArgMaxAggregator<Numeric>;
+
+// Max of the first field, printing the second one.
+ArgMax MakeArgMax() {
+  return ArgMax(Expr<Numeric>{.field = 1},
+                ExprColumn<std::string_view>::FromSpecs(
+                    0, {spec::Expr{.field = 2}}));
+}
+
+ArgMax::State MakeState(ArgMax& aggregator,
+                        const std::vector<std::string>& lines) {
+  InputRow row;
+  row.Reset(lines[0]);
+  ArgMax::State state = aggregator.Init(row);
+  for (size_t i = 1; i < lines.size(); ++i) {
+    row.Reset(lines[i]);
+    aggregator.Update(row, state);
+  }
+  return state;
+}
+
+std::string Print(const ArgMax& aggregator, const ArgMax::State& state) {
+  LastLineTable out;
+  aggregator.Print(state, out);
+  out.EndLine();
+  return out.line;
+}
+
+TEST(ArgMaxAggregator, MergesAcrossStorages) {
+  ArgMax aggregator = MakeArgMax();
+  ArgMax other = MakeArgMax();
+  ArgMax::State state = MakeState(aggregator, {"3 a", "7 b", "5 c"});
+  // Groups stored before, so that handles of the two storages differ.
+  MakeState(other, {"1 x"});
+  MakeState(other, {"2 y", "4 z"});
+  aggregator.Merge(other, MakeState(other, {"6 d", "9 e"}), state);
+  EXPECT_EQ(Print(aggregator, state), "e");
+  // Neither a lower value nor the same one takes over.
+  aggregator.Merge(other, MakeState(other, {"8 f"}), state);
+  aggregator.Merge(other, MakeState(other, {"9 g"}), state);
+  EXPECT_EQ(Print(aggregator, state), "e");
+  // A longer argument replaces a shorter one.
+  aggregator.Merge(other, MakeState(other, {"10 longer"}), state);
+  EXPECT_EQ(Print(aggregator, state), "longer");
+
+  ArgMax::State copy = other.Copy(aggregator, state);
+  EXPECT_EQ(Print(other, copy), "longer");
+  // The copy is independent of the original.
+  aggregator.Merge(aggregator, MakeState(aggregator, {"11 h"}), state);
+  EXPECT_EQ(Print(aggregator, state), "h");
+  EXPECT_EQ(Print(other, copy), "longer");
+}
+
+// Aggregates `lines` into a new state at `state`.
+void Aggregate(AggregatorInterface& aggregator, char* state,
+               const std::vector<std::string>& lines) {
+  InputRow row;
+  row.Reset(lines[0]);
+  aggregator.Init(row, state);
+  for (size_t i = 1; i < lines.size(); ++i) {
+    row.Reset(lines[i]);
+    aggregator.Update(row, state);
+  }
+}
+
+std::string Print(const AggregatorInterface& aggregator, const char* state) {
+  LastLineTable out;
+  aggregator.Print(state, out);
+  out.EndLine();
+  return out.line;
+}
+
+TEST(TypeErasedAggregator, MergesClones) {
+  std::unique_ptr<AggregatorInterface> aggregator =
+      TypeErasedAggregator(MakeArgMax());
+  std::unique_ptr<AggregatorInterface> clone = aggregator->Clone();
+  alignas(8) char state[64], from[64], copy[64];
+  ASSERT_LE(aggregator->StateSize(), sizeof(state));
+
+  Aggregate(*aggregator, state, {"5 a", "2 b"});
+  Aggregate(*clone, from, {"1 x"});
+  Aggregate(*clone, from, {"4 c", "8 d"});
+  aggregator->Merge(*clone, from, state);
+  EXPECT_EQ(Print(*aggregator, state), "d");
+
+  // The clone has a storage of its own.
+  aggregator->Reset();
+  EXPECT_EQ(Print(*clone, from), "d");
+  clone->Copy(*clone, from, copy);
+  EXPECT_EQ(Print(*clone, copy), "d");
+}
+
+}  // namespace
@@ -2,6 +2,15 @@
 
 #include "absl/strings/str_cat.h"
 
+namespace internal {
+
+std::mutex& FailMutex() {
+  static std::mutex mu;
+  return mu;
+}
+
+}  // namespace internal
+
 [[noreturn]] void Unimplemented(std::string_view feature) {
   Fail(feature, " not implemented");
 }
@@ -1,14 +1,25 @@
 #ifndef GITHUB_ZISZIS_ZG_BASE_INCLUDED
 #define GITHUB_ZISZIS_ZG_BASE_INCLUDED
 
+#include <cstdlib>
 #include <iostream>
+#include <mutex>
 #include <string_view>
 
-// Prints message to cerr and stops process with non-zero code.
+namespace internal {
+// Held by the failing thread until the process is gone.
+std::mutex& FailMutex();
+}  // namespace internal
+
+// Prints message to cerr and stops process with non-zero code. Safe to call
+// from several threads at once: only the first one prints, and the process
+// stops right away, without running destructors of objects other threads
+// may still be using.
 template <class... T>
 [[noreturn]] void Fail(T&&... args) {
+  internal::FailMutex().lock();
   (std::cerr << ... << std::forward<T>(args)) << std::endl;
-  std::exit(1);
+  std::_Exit(1);
 }
 
 [[noreturn]] void Unimplemented(std::string_view feature);
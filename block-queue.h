@@ -0,0 +1,70 @@
+#ifndef GITHUB_ZISZIS_ZG_BLOCK_QUEUE_INCLUDED
+#define GITHUB_ZISZIS_ZG_BLOCK_QUEUE_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bounded FIFO queue of data blocks passed between threads. Also keeps
+// consumed blocks around so that their memory can be reused for the following
+// ones.
+class BlockQueue {
+ public:
+  explicit BlockQueue(size_t capacity) : capacity_(capacity) {}
+
+  // Returns an unused (but not necessarily empty) block, blocking while
+  // `capacity` blocks are in flight. Every acquired block must be eventually
+  // Release()d by the consumer.
+  std::string Acquire() {
+    std::unique_lock lock(mu_);
+    not_full_.wait(lock, [&] { return in_flight_ < capacity_; });
+    ++in_flight_;
+    if (free_.empty()) return std::string();
+    std::string result = std::move(free_.back());
+    free_.pop_back();
+    return result;
+  }
+
+  void Push(std::string block) {
+    std::lock_guard lock(mu_);
+    queue_.push_back(std::move(block));
+    not_empty_.notify_one();
+  }
+
+  // Returns false once the queue is closed and drained.
+  bool Pop(std::string* block) {
+    std::unique_lock lock(mu_);
+    not_empty_.wait(lock, [&] { return !queue_.empty() || closed_; });
+    if (queue_.empty()) return false;
+    *block = std::move(queue_.front());
+    queue_.pop_front();
+    return true;
+  }
+
+  void Release(std::string block) {
+    std::lock_guard lock(mu_);
+    free_.push_back(std::move(block));
+    --in_flight_;
+    not_full_.notify_one();
+  }
+
+  void Close() {
+    std::lock_guard lock(mu_);
+    closed_ = true;
+    not_empty_.notify_all();
+  }
+
+ private:
+  std::mutex mu_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<std::string> queue_;
+  std::vector<std::string> free_;
+  size_t capacity_;
+  size_t in_flight_ = 0;
+  bool closed_ = false;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_BLOCK_QUEUE_INCLUDED
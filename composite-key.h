@@ -1,11 +1,16 @@
 #ifndef GITHUB_ZISZIS_ZG_COMPOSITE_KEY_INCLUDED
 #define GITHUB_ZISZIS_ZG_COMPOSITE_KEY_INCLUDED
 
+#include <array>
+#include <charconv>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
-#include "absl/container/flat_hash_set.h"
+#include "hashed-key.h"
+#include "output.h"
+#include "spill.h"
 #include "table.h"
 #include "varint.h"
 
@@ -17,17 +22,21 @@ class BaseCompositeKeyTable : public Table {
  protected:
   void SerializeKey(const InputRow& row) {
     buf_.clear();
+    AppendSerializedKey(row, &buf_);
+  }
+
+  void AppendSerializedKey(const InputRow& row, std::string* out) const {
     for (const auto& key : key_) {
       std::string_view value = row[key.field];
       if (value.size() > std::numeric_limits<uint32_t>::max()) {
         Fail("Key too long, length=", value.size());
       }
-      AppendVarint32(value.size(), &buf_);
-      buf_.append(value);
+      AppendVarint32(value.size(), out);
+      out->append(value);
     }
   }
 
-  void RenderKey(const std::string& serialized_key, OutputTable& out) const {
+  void RenderKey(std::string_view serialized_key, OutputTable& out) const {
     const char* p = serialized_key.data();
     for (const Table::Key& key : key_) {
       uint32_t len = ParseVarint32(p);
@@ -43,62 +52,286 @@ class BaseCompositeKeyTable : public Table {
 template <class Aggregator>
 class CompositeKeyTable : public BaseCompositeKeyTable {
  public:
+  // See SingleKeyTable for `max_memory`.
   CompositeKeyTable(std::vector<Table::Key> key, Aggregator aggregator,
-                    std::unique_ptr<OutputTable> output)
+                    std::unique_ptr<OutputTable> output, size_t max_memory = 0)
       : BaseCompositeKeyTable(std::move(key)),
         aggregator_(std::move(aggregator)),
-        output_(std::move(output)) {}
+        output_(std::move(output)),
+        spiller_(max_memory, aggregator_) {}
 
   void PushRow(const InputRow& row) override {
     SerializeKey(row);
-    auto it = state_.find(buf_);
-    if (it == state_.end()) {
-      state_.emplace_hint(it, buf_, aggregator_.Init(row));
-    } else {
-      aggregator_.Update(row, it->second);
+    state_.InsertOrUpdate(
+        HashedKey(buf_, row.key_hash()),
+        [&] { return aggregator_.Init(row); },
+        [&](State& state) { aggregator_.Update(row, state); });
+    spiller_.MaybeSpill(state_, aggregator_);
+  }
+
+  void PushBatch(Batch rows) override {
+    // Serialize all keys into a single buffer first, then hash them once
+    // the buffer no longer moves.
+    keys_buf_.clear();
+    key_ends_.clear();
+    for (const InputRow* row : rows) {
+      AppendSerializedKey(*row, &keys_buf_);
+      key_ends_.push_back(keys_buf_.size());
     }
+    keys_.clear();
+    size_t key_begin = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      keys_.emplace_back(std::string_view(keys_buf_.data() + key_begin,
+                                          key_ends_[i] - key_begin),
+                         rows[i]->key_hash());
+      key_begin = key_ends_[i];
+    }
+
+    // See SingleKeyTable::PushBatch().
+    updated_rows_.clear();
+    updated_states_.clear();
+    state_.InsertOrUpdateBatch(
+        std::span<const HashedKey>(keys_),
+        [&](size_t i) { return aggregator_.Init(*rows[i]); },
+        [&](size_t i, State& state) {
+          updated_rows_.push_back(rows[i]);
+          updated_states_.push_back(&state);
+        });
+    UpdateBatch(aggregator_, Batch(updated_rows_),
+                std::span<State* const>(updated_states_));
+    spiller_.MaybeSpill(state_, aggregator_);
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<CompositeKeyTable>(key_, aggregator_, nullptr,
+                                               spiller_.max_memory());
+  }
+
+  void Merge(Table& fork) override {
+    auto& that = static_cast<CompositeKeyTable&>(fork);
+    state_.MergeFrom(
+        that.state_,
+        [&](const State& from) {
+          return aggregator_.Copy(that.aggregator_, from);
+        },
+        [&](const State& from, State& state) {
+          aggregator_.Merge(that.aggregator_, from, state);
+        });
+    that.state_.clear();
+    that.aggregator_.Reset();
+    spiller_.Adopt(that.spiller_);
+    spiller_.MaybeSpill(state_, aggregator_);
   }
 
   void Finish() override {
-    for (const auto& [serialized_key, value] : state_) {
-      RenderKey(serialized_key, *output_);
-      aggregator_.Print(value, *output_);
-      output_->EndLine();
-    }
-    decltype(state_)().swap(state_);
+    spiller_.Finish(state_, aggregator_, [&] {
+      for (const auto& [serialized_key, value] : state_) {
+        RenderKey(serialized_key.value(), *output_);
+        aggregator_.Print(value, *output_);
+        output_->EndLine();
+      }
+    });
+    state_.clear();
     aggregator_.Reset();
     output_->Finish();
   }
 
  private:
-  absl::flat_hash_map<std::string, typename Aggregator::State> state_;
+  using State = typename Aggregator::State;
+
+  HashedKeyMap<State> state_;
   Aggregator aggregator_;
   std::unique_ptr<OutputTable> output_;
+  GroupSpiller<Aggregator> spiller_;
+
+  // PushBatch() scratch space.
+  std::string keys_buf_;
+  std::vector<size_t> key_ends_;
+  std::vector<HashedKey> keys_;
+  std::vector<const InputRow*> updated_rows_;
+  std::vector<State*> updated_states_;
 };
 
-class CompositeKeyNoAggregationTable : public BaseCompositeKeyTable {
+// Composite key of N integer fields, packed into fixed-width words. Rows
+// with a key field that isn't an integer written the way it's printed back
+// (see ParseIntKeyField()) are aggregated by a string-keyed table instead, so
+// every group renders exactly as its input text.
+template <class Aggregator, size_t N>
+class IntCompositeKeyTable : public Table {
  public:
-  CompositeKeyNoAggregationTable(std::vector<Table::Key> key,
-                                 std::unique_ptr<OutputTable> output)
-      : BaseCompositeKeyTable(std::move(key)), output_(std::move(output)) {}
+  IntCompositeKeyTable(std::vector<Table::Key> key, Aggregator aggregator,
+                       std::unique_ptr<OutputTable> output)
+      : key_(key),
+        aggregator_(aggregator),
+        output_(std::move(output)),
+        fallback_(std::move(key), std::move(aggregator),
+                  output_ ? MakeForwardingTable(output_->num_columns(),
+                                                output_.get())
+                          : nullptr) {}
 
   void PushRow(const InputRow& row) override {
-    SerializeKey(row);
-    state_.insert(buf_);
+    IntKey key;
+    if (!ParseKey(row, &key)) return fallback_.PushRow(row);
+    bool inserted = false;
+    auto it = state_.lazy_emplace(key, [&](const auto& ctor) {
+      inserted = true;
+      ctor(key, aggregator_.Init(row));
+    });
+    if (!inserted) aggregator_.Update(row, it->second);
+  }
+
+  void PushBatch(Batch rows) override {
+    keys_.clear();
+    int_rows_.clear();
+    fallback_rows_.clear();
+    for (const InputRow* row : rows) {
+      IntKey key;
+      if (ParseKey(*row, &key)) {
+        keys_.push_back(key);
+        int_rows_.push_back(row);
+      } else {
+        fallback_rows_.push_back(row);
+      }
+    }
+    if (!fallback_rows_.empty()) fallback_.PushBatch(Batch(fallback_rows_));
+
+    // See HashedKeyMap::InsertOrUpdateBatch().
+    size_t n = keys_.size();
+    state_.reserve(state_.size() + n);
+    for (size_t i = 0; i < std::min(n, kPrefetchDistance); ++i) {
+      state_.prefetch(keys_[i]);
+    }
+    updated_rows_.clear();
+    updated_states_.clear();
+    for (size_t i = 0; i < n; ++i) {
+      if (i + kPrefetchDistance < n) {
+        state_.prefetch(keys_[i + kPrefetchDistance]);
+      }
+      bool inserted = false;
+      auto it = state_.lazy_emplace(keys_[i], [&](const auto& ctor) {
+        inserted = true;
+        ctor(keys_[i], aggregator_.Init(*int_rows_[i]));
+      });
+      if (!inserted) {
+        updated_rows_.push_back(int_rows_[i]);
+        updated_states_.push_back(&it->second);
+      }
+    }
+    UpdateBatch(aggregator_, Batch(updated_rows_),
+                std::span<State* const>(updated_states_));
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<IntCompositeKeyTable>(key_, aggregator_, nullptr);
+  }
+
+  void Merge(Table& fork) override {
+    auto& that = static_cast<IntCompositeKeyTable&>(fork);
+    for (const auto& [key, value] : that.state_) {
+      bool inserted = false;
+      auto it = state_.lazy_emplace(key, [&](const auto& ctor) {
+        inserted = true;
+        ctor(key, aggregator_.Copy(that.aggregator_, value));
+      });
+      if (!inserted) aggregator_.Merge(that.aggregator_, value, it->second);
+    }
+    decltype(that.state_)().swap(that.state_);
+    that.aggregator_.Reset();
+    fallback_.Merge(that.fallback_);
   }
 
   void Finish() override {
-    for (const auto& serialized_key : state_) {
-      RenderKey(serialized_key, *output_);
+    fallback_.Finish();
+    // Enough for any int64_t.
+    char buf[N][20];
+    for (const auto& [key, value] : state_) {
+      for (size_t i = 0; i < N; ++i) {
+        char* end = std::to_chars(buf[i], buf[i] + sizeof(buf[i]), key[i]).ptr;
+        output_->Set(key_[i].column, std::string_view(buf[i], end - buf[i]));
+      }
+      aggregator_.Print(value, *output_);
       output_->EndLine();
     }
     decltype(state_)().swap(state_);
+    aggregator_.Reset();
     output_->Finish();
   }
 
  private:
-  absl::flat_hash_set<std::string> state_;
+  using State = typename Aggregator::State;
+  using IntKey = std::array<int64_t, N>;
+
+  struct IntKeyHash {
+    size_t operator()(const IntKey& key) const {
+      uint64_t h = 0;
+      for (int64_t word : key) {
+        h = (h ^ static_cast<uint64_t>(word)) * 0x9e3779b97f4a7c15;
+        h ^= h >> 32;
+      }
+      return h;
+    }
+  };
+
+  // Only accepts the canonical spelling of a number ("12", not "012", "+12"
+  // or " 12"), which is what std::to_chars() prints back.
+  static std::optional<int64_t> ParseIntKeyField(std::string_view value) {
+    if (value == "0") return 0;
+    size_t digits = !value.empty() && value[0] == '-';
+    if (value.size() == digits || value[digits] < '1' || value[digits] > '9' ||
+        value.back() < '0' || value.back() > '9') {
+      return std::nullopt;
+    }
+    return TryParseAs<int64_t>(FieldValue(value));
+  }
+
+  bool ParseKey(const InputRow& row, IntKey* key) const {
+    for (size_t i = 0; i < N; ++i) {
+      std::optional<int64_t> value = ParseIntKeyField(row[key_[i].field]);
+      if (!value) return false;
+      (*key)[i] = *value;
+    }
+    return true;
+  }
+
+  absl::flat_hash_map<IntKey, State, IntKeyHash> state_;
+  std::vector<Table::Key> key_;
+  Aggregator aggregator_;
   std::unique_ptr<OutputTable> output_;
+  // Rows with non-integer keys, printed through output_.
+  CompositeKeyTable<Aggregator> fallback_;
+
+  // PushBatch() scratch space.
+  std::vector<IntKey> keys_;
+  std::vector<const InputRow*> int_rows_;
+  std::vector<const InputRow*> fallback_rows_;
+  std::vector<const InputRow*> updated_rows_;
+  std::vector<State*> updated_states_;
 };
 
+// Aggregating table for two or more key fields. With a `max_memory` budget
+// (see SingleKeyTable) all keys are kept as strings, which can be spilled.
+template <class Aggregator>
+std::unique_ptr<Table> MakeCompositeKeyTable(
+    std::vector<Table::Key> key, Aggregator aggregator,
+    std::unique_ptr<OutputTable> output, size_t max_memory = 0) {
+  if (max_memory != 0) {
+    return std::make_unique<CompositeKeyTable<Aggregator>>(
+        std::move(key), std::move(aggregator), std::move(output), max_memory);
+  }
+  switch (key.size()) {
+    case 2:
+      return std::make_unique<IntCompositeKeyTable<Aggregator, 2>>(
+          std::move(key), std::move(aggregator), std::move(output));
+    case 3:
+      return std::make_unique<IntCompositeKeyTable<Aggregator, 3>>(
+          std::move(key), std::move(aggregator), std::move(output));
+    case 4:
+      return std::make_unique<IntCompositeKeyTable<Aggregator, 4>>(
+          std::move(key), std::move(aggregator), std::move(output));
+    default:
+      return std::make_unique<CompositeKeyTable<Aggregator>>(
+          std::move(key), std::move(aggregator), std::move(output));
+  }
+}
+
 #endif  // GITHUB_ZISZIS_ZG_COMPOSITE_KEY_INCLUDED
@@ -0,0 +1,108 @@
+#include "composite-key.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "aggregators.h"
+#include "gtest/gtest.h"
+#include "output.h"
+
+namespace {
+
+// Collects tab-separated lines.
+class CollectingTable : public OutputTable {
+ public:
+  CollectingTable(int num_columns, std::vector<std::string>* lines)
+      : OutputTable(num_columns), lines_(lines) {}
+  void EndLine() override {
+    std::string line(Text(0));
+    for (int i = 1; i < num_columns(); ++i) {
+      absl::StrAppend(&line, "\t", Text(i));
+    }
+    lines_->push_back(std::move(line));
+  }
+  void Finish() override {}
+
+ private:
+  std::vector<std::string>* lines_;
+};
+
+// Counts by the first two fields, which are integers where possible.
+std::unique_ptr<Table> MakeTable(std::vector<std::string>* lines) {
+  return MakeCompositeKeyTable(
+      {Table::Key(1, 0), Table::Key(2, 1)}, CountAggregator(2),
+      std::make_unique<CollectingTable>(3, lines));
+}
+
+void PushBatch(Table& table, const std::vector<std::string>& lines) {
+  std::vector<InputRow> rows(lines.size());
+  std::vector<const InputRow*> batch;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    rows[i].Reset(lines[i]);
+    batch.push_back(&rows[i]);
+  }
+  table.PushBatch(batch);
+}
+
+std::vector<std::string> Sorted(std::vector<std::string> lines) {
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+TEST(IntCompositeKeyTable, PrintsKeysAsInput) {
+  // Integers printed differently, or not fitting in an int64_t, go to the
+  // string-keyed table and are printed exactly as they came.
+  std::vector<std::string> keys = {
+      "007", "-0", "+1", "1", "0", "-1", "-9223372036854775808",
+      "9223372036854775807", "9223372036854775808", "-9223372036854775809",
+      "99999999999999999999", "1.0", "x", "", "-", "1x"};
+  std::vector<std::string> lines;
+  std::unique_ptr<Table> table = MakeTable(&lines);
+  std::vector<std::string> input;
+  std::vector<std::string> expected;
+  for (const std::string& key : keys) {
+    std::string line = absl::StrCat(key, " 5");
+    if (key.empty()) line = "5 ";
+    // Row by row, and then twice more as a batch.
+    InputRow row;
+    row.Reset(line);
+    table->PushRow(row);
+    input.push_back(line);
+    input.push_back(line);
+    expected.push_back(key.empty() ? "5\t\t3" : absl::StrCat(key, "\t5\t3"));
+  }
+  PushBatch(*table, input);
+  table->Finish();
+  EXPECT_EQ(Sorted(lines), Sorted(expected));
+}
+
+TEST(IntCompositeKeyTable, MixesKeysInBatches) {
+  std::vector<std::string> lines;
+  std::unique_ptr<Table> table = MakeTable(&lines);
+  std::unique_ptr<Table> fork = table->Fork();
+  PushBatch(*table, {"1 2", "a 2", "1 2", "1 b", "01 2", "a 2"});
+  PushBatch(*fork, {"a 2", "1 2", "3 4", "01 2"});
+  table->Merge(*fork);
+  PushBatch(*table, {"3 4"});
+  table->Finish();
+  EXPECT_EQ(Sorted(lines), Sorted({"1\t2\t3", "a\t2\t3", "1\tb\t1",
+                                   "01\t2\t2", "3\t4\t2"}));
+}
+
+TEST(IntCompositeKeyTable, PrintsDistinctKeys) {
+  std::vector<std::string> lines;
+  std::unique_ptr<Table> table =
+      MakeCompositeKeyTable({Table::Key(1, 0), Table::Key(2, 1)},
+                            NoAggregator(),
+                            std::make_unique<CollectingTable>(2, &lines));
+  std::unique_ptr<Table> fork = table->Fork();
+  PushBatch(*table, {"1 2", "a 2", "1 2", "01 2"});
+  PushBatch(*fork, {"a 2", "1 2", "3 4"});
+  table->Merge(*fork);
+  table->Finish();
+  EXPECT_EQ(Sorted(lines), Sorted({"1\t2", "a\t2", "01\t2", "3\t4"}));
+}
+
+}  // namespace
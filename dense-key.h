@@ -0,0 +1,198 @@
+#ifndef GITHUB_ZISZIS_ZG_DENSE_KEY_INCLUDED
+#define GITHUB_ZISZIS_ZG_DENSE_KEY_INCLUDED
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <vector>
+
+#include "output.h"
+#include "small-key.h"
+#include "table.h"
+
+// Single key table which starts out indexing an array of states directly by
+// the key, for keys like HTTP statuses or hours which are small non-negative
+// integers. The first key which isn't one (see ParseDenseKey()), or the
+// aggregator taking more than `max_memory`, moves all groups into a
+// SmallKeyTable, which takes all rows from then on.
+template <class Aggregator>
+class DenseKeyTable : public Table {
+ public:
+  // See SingleKeyTable for `max_memory`. The array is bounded by
+  // kMaxDenseKeys and left out of the budget.
+  DenseKeyTable(Table::Key key, Aggregator aggregator,
+                std::unique_ptr<OutputTable> output, size_t max_memory = 0)
+      : key_(key),
+        aggregator_(aggregator),
+        output_(std::move(output)),
+        fallback_(key, std::move(aggregator),
+                  output_ ? MakeForwardingTable(output_->num_columns(),
+                                                output_.get())
+                          : nullptr,
+                  max_memory),
+        max_memory_(max_memory) {}
+
+  void PushRow(const InputRow& row) override {
+    if (dense_) {
+      if (std::optional<uint32_t> key = ParseDenseKey(row[key_.field])) {
+        std::optional<State>& state = Find(*key);
+        if (state) {
+          aggregator_.Update(row, *state);
+        } else {
+          state = aggregator_.Init(row);
+        }
+        return CheckMemory();
+      }
+      SwitchToHashTable();
+    }
+    fallback_.PushRow(row);
+  }
+
+  void PushBatch(Batch rows) override {
+    if (dense_) {
+      keys_.clear();
+      for (const InputRow* row : rows) {
+        std::optional<uint32_t> key = ParseDenseKey((*row)[key_.field]);
+        if (!key) break;
+        keys_.push_back(*key);
+      }
+      if (keys_.size() == rows.size()) {
+        PushDenseBatch(rows);
+        return CheckMemory();
+      }
+      SwitchToHashTable();
+    }
+    fallback_.PushBatch(rows);
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<DenseKeyTable>(key_, aggregator_, nullptr,
+                                           max_memory_);
+  }
+
+  void Merge(Table& fork) override {
+    auto& that = static_cast<DenseKeyTable&>(fork);
+    if (!that.dense_) SwitchToHashTable();
+    for (uint32_t key = 0; key < that.states_.size(); ++key) {
+      const std::optional<State>& from = that.states_[key];
+      if (!from) continue;
+      if (dense_) {
+        std::optional<State>& state = Find(key);
+        if (state) {
+          aggregator_.Merge(that.aggregator_, *from, *state);
+        } else {
+          state = aggregator_.Copy(that.aggregator_, *from);
+        }
+      } else {
+        fallback_.MergeGroup(RenderKey(key), that.aggregator_, *from);
+      }
+    }
+    decltype(that.states_)().swap(that.states_);
+    that.aggregator_.Reset();
+    fallback_.Merge(that.fallback_);
+    CheckMemory();
+  }
+
+  void Finish() override {
+    fallback_.Finish();
+    for (uint32_t key = 0; key < states_.size(); ++key) {
+      if (!states_[key]) continue;
+      output_->Set(key_.column, RenderKey(key));
+      aggregator_.Print(*states_[key], *output_);
+      output_->EndLine();
+    }
+    decltype(states_)().swap(states_);
+    aggregator_.Reset();
+    output_->Finish();
+  }
+
+ private:
+  using State = typename Aggregator::State;
+
+  // Keys are indices into states_, which grows up to this size.
+  static constexpr uint32_t kMaxDenseKeys = 1 << 16;
+
+  // Only accepts the canonical spelling of a number below kMaxDenseKeys, so
+  // that RenderKey() prints back exactly the input text.
+  static std::optional<uint32_t> ParseDenseKey(std::string_view value) {
+    if (value.empty() || value.size() > 5) return std::nullopt;
+    if (value[0] == '0') {
+      return value.size() == 1 ? std::optional<uint32_t>(0) : std::nullopt;
+    }
+    uint32_t result = 0;
+    for (char c : value) {
+      if (c < '0' || c > '9') return std::nullopt;
+      result = result * 10 + (c - '0');
+    }
+    if (result >= kMaxDenseKeys) return std::nullopt;
+    return result;
+  }
+
+  std::string_view RenderKey(uint32_t key) {
+    char* end = std::to_chars(buf_, buf_ + sizeof(buf_), key).ptr;
+    return std::string_view(buf_, end - buf_);
+  }
+
+  std::optional<State>& Find(uint32_t key) {
+    if (key >= states_.size()) {
+      states_.resize(std::max<size_t>(key + 1, 2 * states_.size()));
+    }
+    return states_[key];
+  }
+
+  void PushDenseBatch(Batch rows) {
+    if (rows.empty()) return;
+    // Make sure states don't move while the batch is collected.
+    Find(*std::max_element(keys_.begin(), keys_.end()));
+    updated_rows_.clear();
+    updated_states_.clear();
+    for (size_t i = 0; i < rows.size(); ++i) {
+      std::optional<State>& state = states_[keys_[i]];
+      if (state) {
+        updated_rows_.push_back(rows[i]);
+        updated_states_.push_back(&*state);
+      } else {
+        state = aggregator_.Init(*rows[i]);
+      }
+    }
+    UpdateBatch(aggregator_, Batch(updated_rows_),
+                std::span<State* const>(updated_states_));
+  }
+
+  // See SmallKeyTable::CheckMemory().
+  void CheckMemory() {
+    if (dense_ && max_memory_ != 0 &&
+        aggregator_.MemoryUsage() > max_memory_) {
+      SwitchToHashTable();
+    }
+  }
+
+  void SwitchToHashTable() {
+    if (!dense_) return;
+    for (uint32_t key = 0; key < states_.size(); ++key) {
+      if (states_[key]) {
+        fallback_.MergeGroup(RenderKey(key), aggregator_, *states_[key]);
+      }
+    }
+    decltype(states_)().swap(states_);
+    aggregator_.Reset();
+    dense_ = false;
+  }
+
+  bool dense_ = true;
+  std::vector<std::optional<State>> states_;
+  Table::Key key_;
+  Aggregator aggregator_;
+  std::unique_ptr<OutputTable> output_;
+  // All groups once dense_ is false, printed through output_.
+  SmallKeyTable<Aggregator> fallback_;
+  size_t max_memory_;
+  char buf_[10];
+
+  // PushBatch() scratch space.
+  std::vector<uint32_t> keys_;
+  std::vector<const InputRow*> updated_rows_;
+  std::vector<State*> updated_states_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_DENSE_KEY_INCLUDED
@@ -0,0 +1,106 @@
+#include "dense-key.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "aggregators.h"
+#include "gtest/gtest.h"
+#include "output.h"
+
+namespace {
+
+// Collects lines of key and count.
+class CollectingTable : public OutputTable {
+ public:
+  explicit CollectingTable(std::vector<std::string>* lines)
+      : OutputTable(2), lines_(lines) {}
+  void EndLine() override {
+    lines_->push_back(absl::StrCat(Text(0), " ", Text(1)));
+  }
+  void Finish() override {}
+
+ private:
+  std::vector<std::string>* lines_;
+};
+
+std::unique_ptr<Table> MakeTable(std::vector<std::string>* lines) {
+  return std::make_unique<DenseKeyTable<CountAggregator>>(
+      Table::Key(1, 0), CountAggregator(1),
+      std::make_unique<CollectingTable>(lines));
+}
+
+void PushBatch(Table& table, const std::vector<std::string>& keys) {
+  std::vector<InputRow> rows(keys.size());
+  std::vector<const InputRow*> batch;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    rows[i].Reset(keys[i]);
+    batch.push_back(&rows[i]);
+  }
+  table.PushBatch(batch);
+}
+
+std::vector<std::string> Sorted(std::vector<std::string> lines) {
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+TEST(DenseKeyTable, SwitchesInTheMiddleOfABatch) {
+  std::vector<std::string> lines;
+  std::unique_ptr<Table> table = MakeTable(&lines);
+  PushBatch(*table, {"3", "1", "3"});
+  // Rows before the first non-dense key are counted once, by the hash table.
+  PushBatch(*table, {"3", "2", "x", "2", "1"});
+  PushBatch(*table, {"1", "y"});
+  table->Finish();
+  EXPECT_EQ(Sorted(lines), Sorted({"1 3", "2 2", "3 3", "x 1", "y 1"}));
+}
+
+TEST(DenseKeyTable, BoundsDenseKeys) {
+  std::vector<std::string> lines;
+  std::unique_ptr<Table> table = MakeTable(&lines);
+  PushBatch(*table, {"65535", "0", "65535"});
+  table->Finish();
+  EXPECT_EQ(Sorted(lines), Sorted({"65535 2", "0 1"}));
+
+  // Keys too large for the array, or spelled differently from how they'd be
+  // printed, make the table switch.
+  for (const char* key : {"65536", "00", "01", "99999", "100000", "-1"}) {
+    lines.clear();
+    table = MakeTable(&lines);
+    PushBatch(*table, {"65535", key, "0", key});
+    table->Finish();
+    EXPECT_EQ(Sorted(lines),
+              Sorted({"65535 1", "0 1", absl::StrCat(key, " 2")}))
+        << key;
+  }
+}
+
+TEST(DenseKeyTable, MergesAcrossModes) {
+  std::vector<std::string> lines;
+  std::unique_ptr<Table> table = MakeTable(&lines);
+  std::unique_ptr<Table> dense = table->Fork();
+  std::unique_ptr<Table> hashed = table->Fork();
+  PushBatch(*table, {"1", "x", "2"});
+  PushBatch(*dense, {"1", "7", "7"});
+  PushBatch(*hashed, {"7", "y", "x"});
+  // A dense fork into a table which switched already, and a switched one.
+  table->Merge(*dense);
+  table->Merge(*hashed);
+  table->Finish();
+  EXPECT_EQ(Sorted(lines), Sorted({"1 2", "2 1", "7 3", "x 2", "y 1"}));
+
+  // A switched fork into a dense table.
+  lines.clear();
+  table = MakeTable(&lines);
+  hashed = table->Fork();
+  PushBatch(*table, {"1", "2"});
+  PushBatch(*hashed, {"2", "z"});
+  table->Merge(*hashed);
+  PushBatch(*table, {"1"});
+  table->Finish();
+  EXPECT_EQ(Sorted(lines), Sorted({"1 2", "2 2", "z 1"}));
+}
+
+}  // namespace
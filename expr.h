@@ -51,6 +51,11 @@ inline T Expr<T>::Eval(const InputRow& row) const {
   return T::Make(row[field]);
 }
 
+template <>
+inline Numeric Expr<Numeric>::Eval(const InputRow& row) const {
+  return row.Number(field);
+}
+
 template <class T>
 inline void ExprColumn<T>::Print(const T& value, OutputTable& out) const {
   buf_.clear();
@@ -58,6 +63,12 @@ inline void ExprColumn<T>::Print(const T& value, OutputTable& out) const {
   out.Set(column_, buf_);
 }
 
+template <>
+inline void ExprColumn<Numeric>::Print(const Numeric& value,
+                                       OutputTable& out) const {
+  out.SetNumber(column_, value);
+}
+
 template <>
 inline void ExprColumn<std::string_view>::Print(const std::string_view& value,
                                                 OutputTable& out) const {
@@ -27,11 +27,45 @@ class FilterTable : public Table {
     output_->PushRow(row);
   }
 
+  void PushBatch(Batch rows) override {
+    selected_.assign(rows.begin(), rows.end());
+    for (const auto& f : filters_) {
+      size_t num_selected = 0;
+      for (const InputRow* row : selected_) {
+        std::string_view field = (*row)[f.first];
+        if (re2::RE2::PartialMatch(field, *f.second)) {
+          selected_[num_selected++] = row;
+        }
+      }
+      selected_.resize(num_selected);
+    }
+    if (!selected_.empty()) output_->PushBatch(selected_);
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    std::unique_ptr<Table> output = output_->Fork();
+    if (!output) return nullptr;
+    return std::unique_ptr<Table>(new FilterTable(*this, std::move(output)));
+  }
+
+  void Merge(Table& fork) override {
+    output_->Merge(*static_cast<FilterTable&>(fork).output_);
+  }
+
   void Finish() override { output_->Finish(); }
 
  private:
+  FilterTable(const FilterTable& other, std::unique_ptr<Table> output)
+      : output_(std::move(output)) {
+    for (const auto& f : other.filters_) {
+      filters_.emplace_back(f.first,
+                            std::make_unique<RE2>(f.second->pattern()));
+    }
+  }
+
   std::vector<std::pair<int, std::unique_ptr<RE2>>> filters_;
   std::unique_ptr<Table> output_;
+  std::vector<const InputRow*> selected_;  // PushBatch() scratch space.
 };
 
 }  // namespace
@@ -0,0 +1,153 @@
+#ifndef GITHUB_ZISZIS_ZG_HASHED_KEY_INCLUDED
+#define GITHUB_ZISZIS_ZG_HASHED_KEY_INCLUDED
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "key-arena.h"
+
+// A key together with its precomputed hash. Looking a HashedKey up in a
+// HashedKeyMap reuses the hash instead of computing it again, which lets
+// batched lookups hash every key once, prefetch, and only then probe.
+struct HashedKey {
+  static size_t Hash(std::string_view value) {
+    return absl::Hash<std::string_view>()(value);
+  }
+
+  explicit HashedKey(std::string_view value)
+      : value(value), hash(Hash(value)) {}
+  HashedKey(std::string_view value, size_t hash) : value(value), hash(hash) {}
+  // Only hashes `value` if its hash isn't known yet.
+  HashedKey(std::string_view value, std::optional<size_t> hash)
+      : value(value), hash(hash ? *hash : Hash(value)) {}
+
+  std::string_view value;
+  size_t hash;
+};
+
+// A key stored in a KeyArena, together with its hash. This is what
+// HashedKeyMap slots hold: 16 bytes and no allocation of their own.
+struct ArenaKey {
+  std::string_view value() const { return KeyArena::Load(data); }
+
+  const char* data;
+  size_t hash;
+};
+
+struct HashedKeyHash {
+  using is_transparent = void;
+
+  size_t operator()(std::string_view value) const {
+    return HashedKey::Hash(value);
+  }
+  size_t operator()(const HashedKey& key) const { return key.hash; }
+  size_t operator()(const ArenaKey& key) const { return key.hash; }
+};
+
+struct HashedKeyEq {
+  using is_transparent = void;
+
+  template <class A, class B>
+  bool operator()(const A& a, const B& b) const {
+    // Stored hashes make most mismatches cheap to reject.
+    if constexpr (!std::is_convertible_v<A, std::string_view> &&
+                  !std::is_convertible_v<B, std::string_view>) {
+      if (a.hash != b.hash) return false;
+    }
+    return View(a) == View(b);
+  }
+
+ private:
+  static std::string_view View(std::string_view value) { return value; }
+  static std::string_view View(const HashedKey& key) { return key.value; }
+  static std::string_view View(const ArenaKey& key) { return key.value(); }
+};
+
+// Keys of a batch are probed this far behind the prefetch of their slots.
+inline constexpr size_t kPrefetchDistance = 16;
+
+// Hash map from strings to Value. Keys are copied into an arena, so slots
+// stay small and the map is destroyed without freeing every key separately.
+// Iteration yields pairs of ArenaKey and Value.
+template <class Value>
+class HashedKeyMap {
+ public:
+  auto begin() const { return map_.begin(); }
+  auto end() const { return map_.end(); }
+  size_t size() const { return map_.size(); }
+
+  void swap(HashedKeyMap& other) {
+    map_.swap(other.map_);
+    std::swap(arena_, other.arena_);
+  }
+
+  // Releases all keys and values along with the memory they take.
+  void clear() { HashedKeyMap().swap(*this); }
+
+  // Approximate size of the slots and the arena, not counting anything
+  // values may point to.
+  size_t MemoryUsage() const {
+    return map_.capacity() * (sizeof(typename decltype(map_)::value_type) + 1) +
+           arena_.MemoryUsage();
+  }
+
+  // Calls `update(value)` if `key` is present, otherwise inserts it with the
+  // value returned by `init()`. The key is hashed and probed once.
+  template <class Init, class Update>
+  void InsertOrUpdate(const HashedKey& key, Init init, Update update) {
+    bool inserted = false;
+    auto it = map_.lazy_emplace(key, [&](const auto& ctor) {
+      inserted = true;
+      ctor(ArenaKey{arena_.Store(key.value), key.hash}, init());
+    });
+    if (!inserted) update(it->second);
+  }
+
+  // InsertOrUpdate() for every key of a batch, with `init(i)` and
+  // `update(i, value)` receiving the index of the key. Hashes are computed
+  // by the caller up front; the slots a key probes are prefetched
+  // kPrefetchDistance keys ahead so that the cache misses of a batch
+  // overlap. Room for the whole batch is reserved first, so references
+  // passed to `update` stay valid until the next insertion after the batch.
+  template <class Init, class Update>
+  void InsertOrUpdateBatch(std::span<const HashedKey> keys, Init init,
+                           Update update) {
+    size_t n = keys.size();
+    map_.reserve(map_.size() + n);
+    for (size_t i = 0; i < std::min(n, kPrefetchDistance); ++i) {
+      map_.prefetch(keys[i]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (i + kPrefetchDistance < n) {
+        map_.prefetch(keys[i + kPrefetchDistance]);
+      }
+      InsertOrUpdate(
+          keys[i], [&] { return init(i); },
+          [&](Value& value) { update(i, value); });
+    }
+  }
+
+  // Moves all keys of `from` into this map, calling `init(value)` for keys
+  // new to this map and `update(from_value, value)` for the others. Hashes
+  // stored in `from` are reused.
+  template <class Init, class Update>
+  void MergeFrom(const HashedKeyMap& from, Init init, Update update) {
+    map_.reserve(map_.size() + from.size());
+    for (const auto& [key, from_value] : from) {
+      InsertOrUpdate(
+          HashedKey(key.value(), key.hash), [&] { return init(from_value); },
+          [&](Value& value) { update(from_value, value); });
+    }
+  }
+
+ private:
+  absl::flat_hash_map<ArenaKey, Value, HashedKeyHash, HashedKeyEq> map_;
+  KeyArena arena_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_HASHED_KEY_INCLUDED
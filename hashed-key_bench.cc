@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "absl/strings/str_cat.h"
+#include "base.h"
+#include "hashed-key.h"
+
+// Keys drawn uniformly from `num_distinct` distinct values, with the table
+// already holding all of them.
+struct Workload {
+  explicit Workload(int num_distinct) {
+    std::mt19937 e(42);
+    std::uniform_int_distribution<int> dist(0, num_distinct - 1);
+    for (int i = 0; i < num_distinct; ++i) {
+      distinct.push_back(absl::StrCat("key", i * 7919));
+    }
+    for (int i = 0; i < kNumRows; ++i) keys.push_back(distinct[dist(e)]);
+    for (const std::string& key : distinct) {
+      map.InsertOrUpdate(
+          HashedKey(key), [] { return int64_t{0}; }, [](int64_t&) {});
+    }
+  }
+
+  static constexpr int kNumRows = 1 << 20;
+  std::vector<std::string> distinct;
+  std::vector<std::string_view> keys;
+  HashedKeyMap<int64_t> map;
+};
+
+// Arg: number of distinct keys.
+static void BM_InsertOrUpdate(benchmark::State& state) {
+  Workload w(state.range(0));
+  for (auto _ : state) {
+    for (std::string_view key : w.keys) {
+      w.map.InsertOrUpdate(
+          HashedKey(key), [] { return int64_t{1}; },
+          [](int64_t& count) { ++count; });
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * w.keys.size());
+}
+BENCHMARK(BM_InsertOrUpdate)->RangeMultiplier(8)->Range(1 << 10, 1 << 24);
+
+// Same as above, with keys hashed and prefetched in batches of 1024.
+static void BM_InsertOrUpdateBatch(benchmark::State& state) {
+  constexpr size_t kBatchSize = 1024;
+  Workload w(state.range(0));
+  std::vector<HashedKey> batch;
+  for (auto _ : state) {
+    for (size_t begin = 0; begin < w.keys.size(); begin += kBatchSize) {
+      size_t end = std::min(begin + kBatchSize, w.keys.size());
+      batch.clear();
+      for (size_t i = begin; i < end; ++i) batch.emplace_back(w.keys[i]);
+      w.map.InsertOrUpdateBatch(
+          std::span<const HashedKey>(batch),
+          [](size_t) { return int64_t{1}; },
+          [](size_t, int64_t& count) { ++count; });
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * w.keys.size());
+}
+BENCHMARK(BM_InsertOrUpdateBatch)->RangeMultiplier(8)->Range(1 << 10, 1 << 24);
@@ -0,0 +1,78 @@
+#include "hashed-key.h"
+
+#include <map>
+#include <string>
+
+#include "gtest/gtest.h"
+
+std::map<std::string, int> Contents(const HashedKeyMap<int>& map) {
+  std::map<std::string, int> result;
+  for (const auto& [key, value] : map) {
+    result.emplace(key.value(), value);
+  }
+  return result;
+}
+
+void Add(HashedKeyMap<int>& map, std::string_view key, int x) {
+  map.InsertOrUpdate(
+      HashedKey(key), [&] { return x; }, [&](int& value) { value += x; });
+}
+
+TEST(HashedKeyMap, InsertOrUpdate) {
+  HashedKeyMap<int> map;
+  Add(map, "a", 1);
+  Add(map, "", 2);
+  Add(map, "a", 3);
+  Add(map, std::string("a\0b", 3), 4);
+  EXPECT_EQ(Contents(map), (std::map<std::string, int>{
+                               {"", 2}, {"a", 4}, {std::string("a\0b", 3), 4}}));
+}
+
+TEST(HashedKeyMap, LongKeys) {
+  HashedKeyMap<int> map;
+  std::map<std::string, int> expected;
+  // Spans several arena chunks, including keys larger than a chunk.
+  for (int i = 0; i < 100; ++i) {
+    std::string key(i * 50000, 'a' + i % 26);
+    Add(map, key, i);
+    expected.emplace(key, i);
+  }
+  EXPECT_EQ(Contents(map), expected);
+}
+
+TEST(HashedKeyMap, Batch) {
+  std::vector<std::string> values = {"x", "y", "x", "z", "y", "x"};
+  std::vector<HashedKey> keys;
+  for (const std::string& value : values) keys.emplace_back(value);
+
+  HashedKeyMap<int> map;
+  Add(map, "z", 10);
+  std::vector<size_t> inserted, updated;
+  map.InsertOrUpdateBatch(
+      std::span<const HashedKey>(keys),
+      [&](size_t i) {
+        inserted.push_back(i);
+        return 1;
+      },
+      [&](size_t i, int& value) {
+        updated.push_back(i);
+        ++value;
+      });
+  EXPECT_EQ(inserted, (std::vector<size_t>{0, 1}));
+  EXPECT_EQ(updated, (std::vector<size_t>{2, 3, 4, 5}));
+  EXPECT_EQ(Contents(map),
+            (std::map<std::string, int>{{"x", 3}, {"y", 2}, {"z", 11}}));
+}
+
+TEST(HashedKeyMap, MergeFrom) {
+  HashedKeyMap<int> a, b;
+  Add(a, "x", 1);
+  Add(a, "y", 2);
+  Add(b, "y", 10);
+  Add(b, "z", 20);
+  a.MergeFrom(
+      b, [](int from) { return from + 100; },
+      [](int from, int& value) { value += from; });
+  EXPECT_EQ(Contents(a),
+            (std::map<std::string, int>{{"x", 1}, {"y", 12}, {"z", 120}}));
+}
@@ -0,0 +1,122 @@
+#include "heavy-hitters.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "base.h"
+
+HeavyHittersTable::HeavyHittersTable(std::vector<Table::Key> key,
+                                     int count_column, size_t capacity,
+                                     std::unique_ptr<OutputTable> output)
+    : BaseCompositeKeyTable(std::move(key)),
+      count_column_(count_column),
+      capacity_(capacity),
+      output_(std::move(output)) {
+  if (capacity == 0 || capacity > std::numeric_limits<uint32_t>::max()) {
+    LogicError("bad number of counters");
+  }
+  counters_.reserve(capacity_);
+}
+
+void HeavyHittersTable::Add(std::string_view key, uint64_t count,
+                            uint64_t error) {
+  if (auto it = index_.find(key); it != index_.end()) {
+    Counter& counter = counters_[it->second];
+    counter.count += count;
+    counter.error += error;
+    SiftDown(pos_[it->second]);
+  } else if (counters_.size() < capacity_) {
+    uint32_t id = counters_.size();
+    counters_.push_back({std::string(key), count, error});
+    index_.emplace(counters_.back().key, id);
+    heap_.push_back(id);
+    pos_.push_back(heap_.size() - 1);
+    SiftUp(heap_.size() - 1);
+  } else {
+    uint32_t id = heap_[0];
+    Counter& counter = counters_[id];
+    index_.erase(counter.key);
+    counter.key.assign(key);
+    counter.error = counter.count + error;
+    counter.count += count;
+    index_.emplace(counter.key, id);
+    SiftDown(0);
+  }
+}
+
+void HeavyHittersTable::SiftUp(size_t pos) {
+  uint32_t id = heap_[pos];
+  while (pos > 0) {
+    size_t parent = (pos - 1) / 2;
+    if (!Less(id, heap_[parent])) break;
+    Place(pos, heap_[parent]);
+    pos = parent;
+  }
+  Place(pos, id);
+}
+
+void HeavyHittersTable::SiftDown(size_t pos) {
+  uint32_t id = heap_[pos];
+  while (true) {
+    size_t child = 2 * pos + 1;
+    if (child >= heap_.size()) break;
+    if (child + 1 < heap_.size() && Less(heap_[child + 1], heap_[child])) {
+      ++child;
+    }
+    if (!Less(heap_[child], id)) break;
+    Place(pos, heap_[child]);
+    pos = child;
+  }
+  Place(pos, id);
+}
+
+std::vector<HeavyHittersTable::Counter> HeavyHittersTable::TakeCounters() {
+  index_.clear();
+  heap_.clear();
+  pos_.clear();
+  std::vector<Counter> result = std::move(counters_);
+  counters_ = std::vector<Counter>();
+  counters_.reserve(capacity_);
+  std::sort(result.begin(), result.end(), MoreFrequent);
+  return result;
+}
+
+void HeavyHittersTable::Merge(Table& fork) {
+  auto& that = static_cast<HeavyHittersTable&>(fork);
+  uint64_t min = MinCount();
+  uint64_t that_min = that.MinCount();
+  std::vector<Counter> counters = TakeCounters();
+  std::vector<Counter> theirs = that.TakeCounters();
+
+  absl::flat_hash_map<std::string_view, Counter*> their_index;
+  for (Counter& c : theirs) their_index.emplace(c.key, &c);
+  for (Counter& c : counters) {
+    if (auto it = their_index.find(c.key); it != their_index.end()) {
+      c.count += it->second->count;
+      c.error += it->second->error;
+      their_index.erase(it);
+    } else {
+      c.count += that_min;
+      c.error += that_min;
+    }
+  }
+  for (const auto& [key, c] : their_index) {
+    counters.push_back({std::move(c->key), c->count + min, c->error + min});
+  }
+
+  // The largest counts of the union survive.
+  std::sort(counters.begin(), counters.end(), MoreFrequent);
+  counters.resize(std::min(counters.size(), capacity_));
+  for (const Counter& c : counters) Add(c.key, c.count, c.error);
+}
+
+void HeavyHittersTable::Finish() {
+  for (const Counter& c : TakeCounters()) {
+    RenderKey(c.key, *output_);
+    output_->SetNumber(count_column_, Numeric(static_cast<int64_t>(c.count)));
+    output_->SetNumber(count_column_ + 1,
+                       Numeric(static_cast<int64_t>(c.error)));
+    output_->EndLine();
+  }
+  output_->Finish();
+}
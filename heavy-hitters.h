@@ -0,0 +1,94 @@
+#ifndef GITHUB_ZISZIS_ZG_HEAVY_HITTERS_INCLUDED
+#define GITHUB_ZISZIS_ZG_HEAVY_HITTERS_INCLUDED
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "composite-key.h"
+#include "output.h"
+#include "table.h"
+
+// Approximate counts of the most frequent keys in fixed memory: the
+// Space-Saving algorithm with `capacity` counters. A key which isn't counted
+// yet takes over the counter with the smallest count, and inherits that
+// count as its error. So a count overestimates its key by at most its error,
+// and every key occurring more than n / capacity times in n rows has a
+// counter.
+//
+// Counters form a binary min-heap by count, so the smallest one is always
+// at hand, and counting a row costs a hash lookup and O(log capacity) moves
+// within a few hundred cached counters, however many keys the input has.
+//
+// Prints the counted keys by decreasing count, with the count in
+// `count_column` and its error in the next one.
+class HeavyHittersTable : public BaseCompositeKeyTable {
+ public:
+  HeavyHittersTable(std::vector<Table::Key> key, int count_column,
+                    size_t capacity, std::unique_ptr<OutputTable> output);
+
+  void PushRow(const InputRow& row) override {
+    SerializeKey(row);
+    Add(buf_, 1, 0);
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<HeavyHittersTable>(key_, count_column_, capacity_,
+                                               nullptr);
+  }
+
+  // Summaries of disjoint parts of the input merge into one with the same
+  // guarantees: a key missing from a full summary may have occurred there
+  // as many times as its smallest count, which is added to both its count
+  // and its error.
+  void Merge(Table& fork) override;
+
+  void Finish() override;
+
+ private:
+  struct Counter {
+    std::string key;
+    uint64_t count;
+    uint64_t error;
+  };
+
+  // Orders counters by decreasing count, and then by key so that output
+  // doesn't depend on the order keys came in.
+  static bool MoreFrequent(const Counter& a, const Counter& b) {
+    return a.count > b.count || (a.count == b.count && a.key < b.key);
+  }
+
+  // Counts `count` more occurrences of `key`, `error` of which may not have
+  // been there.
+  void Add(std::string_view key, uint64_t count, uint64_t error);
+  uint64_t MinCount() const {
+    return counters_.size() < capacity_ ? 0 : counters_[heap_[0]].count;
+  }
+  // Counters sorted by decreasing count, leaving the table empty.
+  std::vector<Counter> TakeCounters();
+
+  bool Less(uint32_t a, uint32_t b) const {
+    return counters_[a].count < counters_[b].count;
+  }
+  void Place(size_t pos, uint32_t id) {
+    heap_[pos] = id;
+    pos_[id] = pos;
+  }
+  void SiftUp(size_t pos);
+  void SiftDown(size_t pos);
+
+  int count_column_;
+  size_t capacity_;
+  std::unique_ptr<OutputTable> output_;
+  // Never reallocated, so that index_ can refer to the keys.
+  std::vector<Counter> counters_;
+  absl::flat_hash_map<std::string_view, uint32_t> index_;
+  // Ids of counters (indices into counters_) in heap order, and the
+  // position of every counter in the heap.
+  std::vector<uint32_t> heap_;
+  std::vector<size_t> pos_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_HEAVY_HITTERS_INCLUDED
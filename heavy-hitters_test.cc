@@ -0,0 +1,116 @@
+#include "heavy-hitters.h"
+
+#include <map>
+#include <random>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Collects lines of (key, count, error).
+class CollectingTable : public OutputTable {
+ public:
+  struct Line {
+    std::string key;
+    uint64_t count = 0;
+    uint64_t error = 0;
+  };
+
+  explicit CollectingTable(std::vector<Line>* lines)
+      : OutputTable(3), lines_(lines) {}
+  void EndLine() override {
+    Line line{.key = std::string(Text(0))};
+    EXPECT_TRUE(absl::SimpleAtoi(Text(1), &line.count));
+    EXPECT_TRUE(absl::SimpleAtoi(Text(2), &line.error));
+    lines_->push_back(line);
+  }
+  void Finish() override {}
+
+ private:
+  std::vector<Line>* lines_;
+};
+
+// Zipf-distributed keys, with exact counts.
+std::vector<std::string> ZipfKeys(size_t n, int seed,
+                                  std::map<std::string, uint64_t>* counts) {
+  std::mt19937_64 e(seed);
+  std::vector<double> weights;
+  for (int i = 1; i <= 100000; ++i) weights.push_back(1.0 / i);
+  std::discrete_distribution<int> dist(weights.begin(), weights.end());
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < n; ++i) {
+    keys.push_back(absl::StrCat("key", dist(e)));
+    ++(*counts)[keys.back()];
+  }
+  return keys;
+}
+
+void Push(Table& table, const std::vector<std::string>& keys) {
+  InputRow row;
+  for (const std::string& key : keys) {
+    row.Reset(key);
+    table.PushRow(row);
+  }
+}
+
+void ExpectGuarantees(const std::vector<CollectingTable::Line>& lines,
+                      const std::map<std::string, uint64_t>& counts,
+                      size_t capacity) {
+  uint64_t n = 0;
+  for (const auto& [key, count] : counts) n += count;
+  EXPECT_EQ(lines.size(), capacity);
+  std::map<std::string, CollectingTable::Line> found;
+  for (const auto& line : lines) found[line.key] = line;
+  for (const auto& [key, count] : counts) {
+    auto it = found.find(key);
+    if (count > n / capacity) {
+      ASSERT_NE(it, found.end()) << key;
+    }
+    if (it != found.end()) {
+      EXPECT_LE(it->second.count - it->second.error, count) << key;
+      EXPECT_GE(it->second.count, count) << key;
+    }
+  }
+  for (size_t i = 1; i < lines.size(); ++i) {
+    EXPECT_GE(lines[i - 1].count, lines[i].count);
+  }
+}
+
+TEST(HeavyHittersTable, CountsFrequentKeys) {
+  std::map<std::string, uint64_t> counts;
+  std::vector<std::string> keys = ZipfKeys(1'000'000, 42, &counts);
+  std::vector<CollectingTable::Line> lines;
+  HeavyHittersTable table({Table::Key(0, 0)}, 1, 100,
+                          std::make_unique<CollectingTable>(&lines));
+  Push(table, keys);
+  table.Finish();
+  ExpectGuarantees(lines, counts, 100);
+  // The most frequent key stands out enough to be counted exactly.
+  EXPECT_EQ(lines[0].key, "key0");
+  EXPECT_EQ(lines[0].error, 0);
+}
+
+TEST(HeavyHittersTable, MergesForks) {
+  std::map<std::string, uint64_t> counts;
+  std::vector<CollectingTable::Line> lines;
+  HeavyHittersTable table({Table::Key(0, 0)}, 1, 50,
+                          std::make_unique<CollectingTable>(&lines));
+  std::vector<std::unique_ptr<Table>> forks;
+  for (int i = 0; i < 3; ++i) {
+    forks.push_back(table.Fork());
+    Push(*forks.back(), ZipfKeys(300'000, i, &counts));
+  }
+  // Merged into a table with counts of its own, and one with a few.
+  Push(table, {"key0", "key1", "key0", "rare"});
+  ++counts["key0"];
+  ++counts["key1"];
+  ++counts["key0"];
+  ++counts["rare"];
+  for (auto& fork : forks) table.Merge(*fork);
+  table.Finish();
+  ExpectGuarantees(lines, counts, 50);
+}
+
+}  // namespace
@@ -0,0 +1,225 @@
+#include "hyperloglog.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "base.h"
+
+namespace {
+
+// Finalizer of MurmurHash3, which mixes every bit of the input into every
+// bit of the output.
+uint64_t Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccd;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53;
+  x ^= x >> 33;
+  return x;
+}
+
+}  // namespace
+
+ApproxCountDistinctAggregator::ApproxCountDistinctAggregator(
+    int column, Expr<std::string_view> expr, int precision)
+    : column_(column),
+      expr_(expr),
+      precision_(precision),
+      num_registers_(uint32_t{1} << precision),
+      max_sparse_(std::max(kInlineRegisters, num_registers_ / 16)) {
+  // Registers hold ranks of up to 64 - precision + 1 in kRankBits bits, and
+  // sparse entries hold indices in the rest.
+  if (precision < 4 || precision > 32 - kRankBits) {
+    LogicError("HyperLogLog precision out of range");
+  }
+}
+
+uint64_t ApproxCountDistinctAggregator::Hash(std::string_view value) {
+  const char* p = value.data();
+  size_t n = value.size();
+  uint64_t hash = Mix(n + 0x9e3779b97f4a7c15);
+  uint64_t word;
+  for (; n >= sizeof(word); p += sizeof(word), n -= sizeof(word)) {
+    memcpy(&word, p, sizeof(word));
+    hash = Mix(hash ^ word);
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, p, n);
+  return Mix(hash ^ tail);
+}
+
+void ApproxCountDistinctAggregator::Add(State& state, uint64_t hash) {
+  // The top bits pick a register, which keeps the longest run of leading
+  // zeros seen in the rest (plus one). The bit or'ed in caps the rank at
+  // 64 - precision_ + 1.
+  uint32_t index = hash >> (64 - precision_);
+  uint64_t rest = hash << precision_ | uint64_t{1} << (precision_ - 1);
+  Set(state, index, std::countl_zero(rest) + 1);
+}
+
+void ApproxCountDistinctAggregator::Set(State& state, uint32_t index,
+                                        uint8_t rank) {
+  if (state.size != kDense) {
+    uint32_t* entries = SparseRegisters(state);
+    uint32_t* it =
+        std::lower_bound(entries, entries + state.size, Entry(index, 0));
+    if (it != entries + state.size && Index(*it) == index) {
+      *it = std::max(*it, Entry(index, rank));
+      return;
+    }
+    if (state.size < max_sparse_) {
+      InsertSparse(state, it - entries, Entry(index, rank));
+      return;
+    }
+    MakeDense(state);
+  }
+  uint8_t& reg = dense_[state.handle][index];
+  reg = std::max(reg, rank);
+}
+
+void ApproxCountDistinctAggregator::InsertSparse(State& state, size_t pos,
+                                                 uint32_t entry) {
+  if (state.size < kInlineRegisters) {
+    std::copy_backward(state.registers + pos, state.registers + state.size,
+                       state.registers + state.size + 1);
+    state.registers[pos] = entry;
+  } else {
+    size_t capacity = 0;
+    if (state.size == kInlineRegisters) {
+      if (sparse_.size() == std::numeric_limits<uint32_t>::max()) {
+        Fail("Too many groups for count(approx_distinct)");
+      }
+      sparse_.emplace_back(state.registers,
+                           state.registers + kInlineRegisters);
+      state.handle = sparse_.size() - 1;
+    } else {
+      capacity = sparse_[state.handle].capacity();
+    }
+    std::vector<uint32_t>& list = sparse_[state.handle];
+    list.insert(list.begin() + pos, entry);
+    sparse_memory_ += (list.capacity() - capacity) * sizeof(uint32_t);
+  }
+  ++state.size;
+}
+
+void ApproxCountDistinctAggregator::MakeDense(State& state) {
+  if (dense_.size() == kDense) {
+    Fail("Too many groups for count(approx_distinct)");
+  }
+  std::vector<uint8_t>& registers = dense_.emplace_back(num_registers_);
+  const uint32_t* entries = SparseRegisters(state);
+  for (uint32_t i = 0; i < state.size; ++i) {
+    registers[Index(entries[i])] = Rank(entries[i]);
+  }
+  if (state.size > kInlineRegisters) {
+    std::vector<uint32_t>& list = sparse_[state.handle];
+    sparse_memory_ -= list.capacity() * sizeof(uint32_t);
+    std::vector<uint32_t>().swap(list);
+  }
+  state.size = kDense;
+  state.handle = dense_.size() - 1;
+}
+
+void ApproxCountDistinctAggregator::Merge(
+    const ApproxCountDistinctAggregator& from, const State& s, State& state) {
+  if (s.size == kDense) {
+    if (state.size != kDense) MakeDense(state);
+    const std::vector<uint8_t>& theirs = from.dense_[s.handle];
+    std::vector<uint8_t>& ours = dense_[state.handle];
+    for (uint32_t i = 0; i < num_registers_; ++i) {
+      ours[i] = std::max(ours[i], theirs[i]);
+    }
+  } else {
+    // Entries are looked up every time, as `from` may be this aggregator,
+    // whose lists move as they are added.
+    for (uint32_t i = 0; i < s.size; ++i) {
+      uint32_t entry = from.SparseRegisters(s)[i];
+      Set(state, Index(entry), Rank(entry));
+    }
+  }
+}
+
+double ApproxCountDistinctAggregator::Estimate(const State& state) const {
+  double sum = 0;
+  uint32_t zeros = 0;
+  if (state.size == kDense) {
+    for (uint8_t rank : dense_[state.handle]) {
+      sum += std::ldexp(1.0, -rank);
+      zeros += rank == 0;
+    }
+  } else {
+    zeros = num_registers_ - state.size;
+    sum = zeros;
+    const uint32_t* entries = SparseRegisters(state);
+    for (uint32_t i = 0; i < state.size; ++i) {
+      sum += std::ldexp(1.0, -Rank(entries[i]));
+    }
+  }
+
+  double m = num_registers_;
+  double alpha = m == 16   ? 0.673
+                 : m == 32 ? 0.697
+                 : m == 64 ? 0.709
+                           : 0.7213 / (1 + 1.079 / m);
+  double estimate = alpha * m * m / sum;
+  // Small cardinalities are estimated better by the number of registers
+  // still unset (linear counting). With 64 bit hashes there's no need for a
+  // correction at the other end.
+  if (estimate <= 2.5 * m && zeros != 0) estimate = m * std::log(m / zeros);
+  return estimate;
+}
+
+void ApproxCountDistinctAggregator::Print(const State& state,
+                                          OutputTable& out) const {
+  out.SetNumber(column_,
+                Numeric(static_cast<int64_t>(std::llround(Estimate(state)))));
+}
+
+void ApproxCountDistinctAggregator::Reset() {
+  decltype(sparse_)().swap(sparse_);
+  sparse_memory_ = 0;
+  decltype(dense_)().swap(dense_);
+}
+
+void ApproxCountDistinctAggregator::Save(const State& state,
+                                         std::string* out) const {
+  out->append(reinterpret_cast<const char*>(&state.size),
+              sizeof(state.size));
+  if (state.size == kDense) {
+    const std::vector<uint8_t>& registers = dense_[state.handle];
+    out->append(reinterpret_cast<const char*>(registers.data()),
+                registers.size());
+  } else {
+    out->append(reinterpret_cast<const char*>(SparseRegisters(state)),
+                state.size * sizeof(uint32_t));
+  }
+}
+
+ApproxCountDistinctAggregator::State ApproxCountDistinctAggregator::Load(
+    const char*& p) {
+  uint32_t size;
+  memcpy(&size, p, sizeof(size));
+  p += sizeof(size);
+  State state = {};
+  if (size == kDense) {
+    MakeDense(state);
+    memcpy(dense_[state.handle].data(), p, num_registers_);
+    p += num_registers_;
+  } else {
+    for (uint32_t i = 0; i < size; ++i, p += sizeof(uint32_t)) {
+      uint32_t entry;
+      memcpy(&entry, p, sizeof(entry));
+      Set(state, Index(entry), Rank(entry));
+    }
+  }
+  return state;
+}
+
+size_t ApproxCountDistinctAggregator::MemoryUsage() const {
+  return sparse_.capacity() * sizeof(sparse_[0]) + sparse_memory_ +
+         dense_.capacity() * sizeof(dense_[0]) +
+         dense_.size() * num_registers_;
+}
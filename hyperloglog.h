@@ -0,0 +1,114 @@
+#ifndef GITHUB_ZISZIS_ZG_HYPERLOGLOG_INCLUDED
+#define GITHUB_ZISZIS_ZG_HYPERLOGLOG_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "expr.h"
+#include "output.h"
+#include "types.h"
+
+// Approximate number of distinct values in a group, estimated with a
+// HyperLogLog sketch of 2^precision registers. The standard error is about
+// 1.04 / sqrt(2^precision): 0.8% with the default precision of 14.
+//
+// A sketch starts out sparse, as the list of registers set so far sorted by
+// index, the first kInlineRegisters of which fit in the state itself. Once
+// the list would take a sixteenth of the registers (at 4 bytes an entry, a
+// quarter of their size) it's replaced by all 2^precision registers, a byte
+// each. So a group takes a 16 byte state and at most 2^precision more bytes,
+// and groups with few distinct values take little more than the state.
+//
+// Sketches live in the aggregator, states only refer to them, and they are
+// all released by Reset(). Sketches with the same precision merge without
+// losing anything, so partial aggregation in threads or partitions gives the
+// same estimates as a single pass. Values are hashed with a fixed function,
+// so estimates don't change from one run to the next either.
+class ApproxCountDistinctAggregator {
+ public:
+  struct State {
+    // Number of registers set while the sketch is sparse, kDense afterwards.
+    uint32_t size;
+    // Index into sparse_ if size > kInlineRegisters, of the registers in
+    // dense_ if kDense.
+    uint32_t handle;
+    // The sparse registers while size <= kInlineRegisters, see Entry().
+    uint32_t registers[2];
+  };
+
+  ApproxCountDistinctAggregator(int column, Expr<std::string_view> expr,
+                                int precision);
+
+  State Init(const InputRow& row) {
+    State state = {};
+    Add(state, Hash(expr_.Eval(row)));
+    return state;
+  }
+  void Update(const InputRow& row, State& state) {
+    Add(state, Hash(expr_.Eval(row)));
+  }
+  State Copy(const ApproxCountDistinctAggregator& from, const State& s) {
+    State state = {};
+    Merge(from, s, state);
+    return state;
+  }
+  void Merge(const ApproxCountDistinctAggregator& from, const State& s,
+             State& state);
+  void Print(const State& state, OutputTable& out) const;
+  void Reset();
+  void Save(const State& state, std::string* out) const;
+  State Load(const char*& p);
+  size_t MemoryUsage() const;
+
+  // The estimated number of distinct values.
+  double Estimate(const State& state) const;
+
+  // 64 bit hash of a value, the same in every run.
+  static uint64_t Hash(std::string_view value);
+
+ private:
+  static constexpr uint32_t kDense = ~uint32_t{0};
+  static constexpr uint32_t kInlineRegisters = 2;
+  static constexpr int kRankBits = 6;
+
+  // A sparse register: its index above kRankBits bits of its value, so
+  // entries sort by index, and of two entries for the same register the
+  // greater one holds the greater value.
+  static uint32_t Entry(uint32_t index, uint8_t rank) {
+    return index << kRankBits | rank;
+  }
+  static uint32_t Index(uint32_t entry) { return entry >> kRankBits; }
+  static uint8_t Rank(uint32_t entry) {
+    return entry & ((1 << kRankBits) - 1);
+  }
+
+  void Add(State& state, uint64_t hash);
+  // Sets register `index` to `rank` unless it's greater already.
+  void Set(State& state, uint32_t index, uint8_t rank);
+  void InsertSparse(State& state, size_t pos, uint32_t entry);
+  void MakeDense(State& state);
+
+  uint32_t* SparseRegisters(State& state) {
+    return state.size <= kInlineRegisters ? state.registers
+                                          : sparse_[state.handle].data();
+  }
+  const uint32_t* SparseRegisters(const State& state) const {
+    return state.size <= kInlineRegisters ? state.registers
+                                          : sparse_[state.handle].data();
+  }
+
+  int column_;
+  Expr<std::string_view> expr_;
+  int precision_;
+  uint32_t num_registers_;
+  // Longest sparse list, past which a sketch is made dense.
+  uint32_t max_sparse_;
+  std::vector<std::vector<uint32_t>> sparse_;
+  // Bytes taken by the lists in sparse_.
+  size_t sparse_memory_ = 0;
+  // Registers of dense sketches, 2^precision each.
+  std::vector<std::vector<uint8_t>> dense_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_HYPERLOGLOG_INCLUDED
@@ -0,0 +1,103 @@
+#include "hyperloglog.h"
+
+#include <cmath>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using State = ApproxCountDistinctAggregator::State;
+
+ApproxCountDistinctAggregator MakeAggregator(int precision) {
+  return ApproxCountDistinctAggregator(0, Expr<std::string_view>{.field = 0},
+                                       precision);
+}
+
+// Adds values `begin`, ..., `end - 1` (each twice) to `state`.
+void AddRange(ApproxCountDistinctAggregator& aggregator, State& state,
+              int begin, int end) {
+  InputRow row;
+  for (int round = 0; round < 2; ++round) {
+    for (int i = begin; i < end; ++i) {
+      std::string value = absl::StrCat("value", i);
+      row.Reset(value);
+      aggregator.Update(row, state);
+    }
+  }
+}
+
+State MakeState(ApproxCountDistinctAggregator& aggregator, int begin,
+                int end) {
+  InputRow row;
+  std::string value = absl::StrCat("value", begin);
+  row.Reset(value);
+  State state = aggregator.Init(row);
+  AddRange(aggregator, state, begin + 1, end);
+  return state;
+}
+
+TEST(ApproxCountDistinct, SmallCountsAreExact) {
+  ApproxCountDistinctAggregator aggregator = MakeAggregator(14);
+  for (int n : {1, 2, 3, 10, 100}) {
+    State state = MakeState(aggregator, 0, n);
+    EXPECT_EQ(std::llround(aggregator.Estimate(state)), n);
+  }
+}
+
+TEST(ApproxCountDistinct, WithinStandardError) {
+  for (int precision : {10, 14}) {
+    ApproxCountDistinctAggregator aggregator = MakeAggregator(precision);
+    double error = 1.04 / std::sqrt(1 << precision);
+    for (int n : {1000, 10000, 100000, 1000000}) {
+      State state = MakeState(aggregator, 0, n);
+      EXPECT_NEAR(aggregator.Estimate(state), n, 3 * error * n)
+          << "precision " << precision;
+    }
+  }
+}
+
+TEST(ApproxCountDistinct, MergesLosslessly) {
+  ApproxCountDistinctAggregator aggregator = MakeAggregator(12);
+  ApproxCountDistinctAggregator other = MakeAggregator(12);
+  for (int n : {5, 100, 50000}) {
+    State all = MakeState(aggregator, 0, n);
+    // Overlapping halves, in another aggregator and in this one.
+    State state = MakeState(aggregator, 0, n * 2 / 3);
+    State from_other = MakeState(other, n / 3, n);
+    aggregator.Merge(other, from_other, state);
+    EXPECT_EQ(aggregator.Estimate(state), aggregator.Estimate(all));
+
+    State copy = other.Copy(aggregator, state);
+    EXPECT_EQ(other.Estimate(copy), aggregator.Estimate(all));
+  }
+}
+
+TEST(ApproxCountDistinct, SavesAndLoads) {
+  ApproxCountDistinctAggregator aggregator = MakeAggregator(14);
+  for (int n : {1, 3, 500, 100000}) {
+    State state = MakeState(aggregator, 0, n);
+    std::string saved;
+    aggregator.Save(state, &saved);
+    ApproxCountDistinctAggregator loader = MakeAggregator(14);
+    const char* p = saved.data();
+    State loaded = loader.Load(p);
+    EXPECT_EQ(p, saved.data() + saved.size());
+    EXPECT_EQ(loader.Estimate(loaded), aggregator.Estimate(state));
+  }
+}
+
+TEST(ApproxCountDistinct, MemoryGrowsWithDistinctValues) {
+  ApproxCountDistinctAggregator aggregator = MakeAggregator(14);
+  // Groups with up to two distinct values live in their states.
+  for (int i = 0; i < 1000; ++i) MakeState(aggregator, i, i + 2);
+  EXPECT_EQ(aggregator.MemoryUsage(), 0);
+  // Larger ones never take more than all registers.
+  for (int i = 0; i < 10; ++i) MakeState(aggregator, 0, 1 << i);
+  for (int i = 0; i < 10; ++i) MakeState(aggregator, 0, 100000);
+  EXPECT_LT(aggregator.MemoryUsage(), 25 * (1 << 14));
+  aggregator.Reset();
+  EXPECT_EQ(aggregator.MemoryUsage(), 0);
+}
+
+}  // namespace
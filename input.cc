@@ -1,39 +1,276 @@
 #include "input.h"
 
-#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// next_in of z_stream is a pointer to const.
+#define ZLIB_CONST
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <limits>
 #include <string>
+#include <thread>
+
+#include "base.h"
+#include "spsc-queue.h"
+
+namespace {
+
+// Reads `size` bytes unless the input ends earlier.
+size_t ReadFully(int fd, char* buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, buf + done, size - done);
+    if (n == 0) break;
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      Fail("Read failed: ", std::strerror(errno));
+    }
+    done += n;
+  }
+  return done;
+}
+
+// Buffers in the pool of a background reader.
+constexpr size_t kReadBuffers = 4;
+
+// The first `size` bytes of `buf` are whole lines (but for the very last
+// line of the input). The rest of `buf` is only there to be reused.
+struct Block {
+  std::string buf;
+  size_t size = 0;
+};
+
+// Fills `buf` with `size` bytes of input, or fewer once the input ends.
+using ReadFn = std::function<size_t(char* buf, size_t size)>;
 
-void ForEachInputLine(const std::function<void(const char*, const char*)>& fn) {
-  std::string buffer(16384, '\0');
-  char* begin = buffer.data();
-  size_t bufferLeft = 0;
+// Fills blocks until the input ends, then closes `queue`. The partial line
+// at the end of a block is carried over to the next one, and a block with no
+// newline is grown until the line fits.
+void ReadBlocks(const ReadFn& read, size_t min_block_size,
+                SpscQueue<Block>& queue) {
+  std::string carry;
+  bool eof = false;
+  while (!eof) {
+    Block& block = *queue.BeginPush();
+    size_t want = std::max(min_block_size, 2 * carry.size());
+    if (block.buf.size() < want) block.buf.resize(want);
+    memcpy(block.buf.data(), carry.data(), carry.size());
+    size_t size = carry.size();
+    carry.clear();
 
-  while (true) {
-    size_t wantToRead = buffer.size() - bufferLeft;
-    size_t actuallyRead = std::fread(begin + bufferLeft, 1, wantToRead, stdin);
-    bufferLeft += actuallyRead;
+    const char* last = nullptr;
     while (true) {
-      char* p = static_cast<char*>(memchr(begin, '\n', bufferLeft));
-      if (p != nullptr) {
-        fn(begin, p);
-        ++p;
-        bufferLeft -= p - begin;
-        begin = p;
-      } else if (wantToRead == actuallyRead) {
-        memmove(buffer.data(), begin, bufferLeft);
-        if (bufferLeft > buffer.size() / 4) {
-          buffer.resize(buffer.size() * 4, '\0');
-        }
-        begin = buffer.data();
-        // TODO: Shrink buffer if too little of it is used?
+      char* end = block.buf.data() + size;
+      size += read(end, block.buf.size() - size);
+      if (size != block.buf.size()) {
+        eof = true;
         break;
-      } else {
-        if (bufferLeft != 0) {
-          fn(begin, begin + bufferLeft);
-        }
-        return;
       }
+      last = static_cast<const char*>(memrchr(block.buf.data(), '\n', size));
+      if (last != nullptr) break;
+      block.buf.resize(block.buf.size() * 4);
     }
+    if (!eof) {
+      size_t complete = last + 1 - block.buf.data();
+      carry.assign(block.buf.data() + complete, size - complete);
+      size = complete;
+    }
+    block.size = size;
+    if (size != 0) queue.EndPush();
   }
+  queue.Close();
+}
+
+// Input is read by a background thread (see ForEachInputBlock()).
+void ForEachBlockInBackground(
+    const ReadFn& read, size_t min_block_size,
+    const std::function<void(const char*, const char*)>& fn) {
+  SpscQueue<Block> queue(kReadBuffers);
+  std::thread reader([&] { ReadBlocks(read, min_block_size, queue); });
+  while (const Block* block = queue.BeginPop()) {
+    fn(block->buf.data(), block->buf.data() + block->size);
+    queue.EndPop();
+  }
+  reader.join();
+}
+
+// Decompresses gzip input: `data`, followed by the rest of `fd` unless it's
+// -1. Members following each other are decompressed one after another, as
+// gzip -d does.
+class GzipReader {
+ public:
+  GzipReader(std::string_view data, int fd) : fd_(fd), input_(data) {
+    // 16 + window bits: gzip format only.
+    if (inflateInit2(&z_, 16 + MAX_WBITS) != Z_OK) {
+      Fail("Failed to start gzip decompression");
+    }
+  }
+  ~GzipReader() { inflateEnd(&z_); }
+
+  size_t Read(char* buf, size_t size) {
+    size_t done = 0;
+    while (done < size && !ended_) {
+      if (z_.avail_in == 0 && !Refill()) {
+        if (in_member_) Fail("Truncated gzip input");
+        ended_ = true;
+        break;
+      }
+      z_.next_out = reinterpret_cast<Bytef*>(buf + done);
+      z_.avail_out = std::min<size_t>(size - done,
+                                      std::numeric_limits<uInt>::max());
+      size_t avail_out = z_.avail_out;
+      in_member_ = true;
+      int ret = inflate(&z_, Z_NO_FLUSH);
+      done += avail_out - z_.avail_out;
+      if (ret == Z_STREAM_END) {
+        in_member_ = false;
+        inflateReset(&z_);
+      } else if (ret != Z_OK) {
+        Fail("Failed to decompress gzip input: ",
+             z_.msg ? z_.msg : "corrupt data");
+      }
+    }
+    return done;
+  }
+
+ private:
+  // Reads more compressed input, returns false at its end. zlib counts
+  // input in 32 bits, so `input_` is passed on in chunks.
+  bool Refill() {
+    if (!input_.empty()) {
+      size_t n = std::min(input_.size(), internal::max_gzip_chunk);
+      z_.next_in = reinterpret_cast<const Bytef*>(input_.data());
+      z_.avail_in = n;
+      input_.remove_prefix(n);
+      return true;
+    }
+    if (fd_ < 0) return false;
+    if (buf_.empty()) buf_.resize(1 << 20);
+    size_t n = ReadFully(fd_, buf_.data(), buf_.size());
+    z_.next_in = reinterpret_cast<const Bytef*>(buf_.data());
+    z_.avail_in = n;
+    return n != 0;
+  }
+
+  int fd_;
+  // Input not passed to zlib yet, read before `fd_`.
+  std::string_view input_;
+  std::string buf_;
+  z_stream z_ = {};
+  bool in_member_ = false;
+  bool ended_ = false;
+};
+
+// Whether `data` starts with the magic bytes of a compression format:
+// gzip's, which is decompressed, or zstd's, which is refused.
+bool IsCompressed(std::string_view data) {
+  if (data.starts_with("\x28\xb5\x2f\xfd")) {
+    Unimplemented("Reading zstd-compressed input (use zstdcat)");
+  }
+  return data.starts_with("\x1f\x8b");
+}
+
+}  // namespace
+
+namespace internal {
+size_t max_gzip_chunk = std::numeric_limits<uInt>::max();
+}  // namespace internal
+
+std::string_view CutBlock(std::string_view* data, size_t min_block_size) {
+  size_t size = data->size();
+  if (size > min_block_size) {
+    const char* p = static_cast<const char*>(
+        memchr(data->data() + min_block_size - 1, '\n',
+               size - min_block_size + 1));
+    if (p != nullptr) size = p + 1 - data->data();
+  }
+  std::string_view block = data->substr(0, size);
+  data->remove_prefix(size);
+  return block;
+}
+
+std::unique_ptr<MappedFile> MappedFile::Map(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return nullptr;
+  // Files of procfs and sysfs have content but no size.
+  if (st.st_size == 0) return nullptr;
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  if (offset < 0 || offset > st.st_size) return nullptr;
+  if (offset == st.st_size) {
+    return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0, {}));
+  }
+
+  // mmap() wants a page-aligned offset.
+  off_t aligned = offset / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+  size_t size = st.st_size - aligned;
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, aligned);
+  if (addr == MAP_FAILED) return nullptr;
+  madvise(addr, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise(addr, size, MADV_HUGEPAGE);
+#endif
+  std::string_view contents(static_cast<const char*>(addr) + (offset - aligned),
+                            st.st_size - offset);
+  return std::unique_ptr<MappedFile>(new MappedFile(addr, size, contents));
+}
+
+MappedFile::~MappedFile() {
+  if (addr_ != nullptr) munmap(addr_, size_);
+}
+
+void ForEachInputLine(int fd,
+                      const std::function<void(const char*, const char*)>& fn) {
+  ForEachInputBlock(fd, 16384, [&](const char* begin, const char* end) {
+    ForEachLineInBlock(begin, end, fn);
+  });
+}
+
+void ForEachInputBlock(
+    int fd, size_t min_block_size,
+    const std::function<void(const char*, const char*)>& fn) {
+  if (std::unique_ptr<MappedFile> mapped = MappedFile::Map(fd)) {
+    std::string_view data = mapped->contents();
+    if (IsCompressed(data)) {
+      GzipReader gzip(data, -1);
+      ForEachBlockInBackground(
+          [&](char* buf, size_t size) { return gzip.Read(buf, size); },
+          min_block_size, fn);
+      return;
+    }
+    while (!data.empty()) {
+      std::string_view block = CutBlock(&data, min_block_size);
+      fn(block.data(), block.data() + block.size());
+    }
+    return;
+  }
+
+  // Enough of the input to tell whether it's compressed, which is read again
+  // (from here) along with the rest.
+  std::string head(4, '\0');
+  head.resize(ReadFully(fd, head.data(), head.size()));
+  if (IsCompressed(head)) {
+    GzipReader gzip(head, fd);
+    ForEachBlockInBackground(
+        [&](char* buf, size_t size) { return gzip.Read(buf, size); },
+        min_block_size, fn);
+    return;
+  }
+  size_t head_read = 0;
+  ForEachBlockInBackground(
+      [&](char* buf, size_t size) {
+        size_t n = std::min(size, head.size() - head_read);
+        memcpy(buf, head.data() + head_read, n);
+        head_read += n;
+        return n + ReadFully(fd, buf + n, size - n);
+      },
+      min_block_size, fn);
+}
+
+bool IsCompressedInput(const MappedFile& file) {
+  return IsCompressed(file.contents());
 }
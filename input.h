@@ -1,13 +1,89 @@
 #ifndef GITHUB_ZISZIS_ZG_INPUT_INCLUDED
 #define GITHUB_ZISZIS_ZG_INPUT_INCLUDED
 
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <string_view>
 
-// Reads stdin, calls `fn` for each line (line terminator is not included in
-// fn's arguments).
+// Reads `fd` until the end, calls `fn` for each line (line terminator is not
+// included in fn's arguments).
 //
 // Note, linefeed character is not specially handled (i.e. is
 // passed to `fn` as a regular line byte).
-void ForEachInputLine(const std::function<void(const char*, const char*)>& fn);
+void ForEachInputLine(int fd,
+                      const std::function<void(const char*, const char*)>& fn);
+
+// Reads `fd` until the end, calls `fn` for blocks of whole lines (each one
+// terminated by '\n', except maybe the very last line of the input). Blocks
+// are at least `min_block_size` bytes long unless the input ends. The block
+// memory is only valid until `fn` returns.
+//
+// Regular files are memory-mapped, so that blocks point right into the page
+// cache. Other inputs (e.g. pipes) are read by a background thread into a
+// few buffers of `min_block_size`, which it cuts at their last newline
+// (growing them for lines that don't fit), so `fn` never waits for a read
+// that could have been done while it was busy.
+//
+// Gzip-compressed input (told by its magic bytes) is decompressed by that
+// thread too, right into the blocks.
+void ForEachInputBlock(int fd, size_t min_block_size,
+                       const std::function<void(const char*, const char*)>& fn);
+
+// Cuts a block of whole lines at least `min_block_size` bytes long (or all
+// of `data` if it's shorter) off the front of `data`.
+std::string_view CutBlock(std::string_view* data, size_t min_block_size);
+
+// Calls `fn` for each line of the block produced by ForEachInputBlock().
+template <class Fn>
+void ForEachLineInBlock(const char* begin, const char* end, Fn&& fn);
+
+// Read-only mapping of a regular file, from the current offset of `fd` to
+// its end.
+class MappedFile {
+ public:
+  // Returns nullptr if `fd` can't be mapped (e.g. is a pipe, or reports no
+  // size, as files of /proc do).
+  static std::unique_ptr<MappedFile> Map(int fd);
+  ~MappedFile();
+
+  std::string_view contents() const { return contents_; }
+
+ private:
+  MappedFile(void* addr, size_t size, std::string_view contents)
+      : addr_(addr), size_(size), contents_(contents) {}
+
+  void* addr_;
+  size_t size_;
+  std::string_view contents_;
+};
+
+// Whether `file` is compressed, so that lines have to come from
+// ForEachInputBlock() rather than its contents().
+bool IsCompressedInput(const MappedFile& file);
+
+namespace internal {
+// Most compressed input handed to zlib at once, lowered by tests.
+extern size_t max_gzip_chunk;
+}  // namespace internal
+
+//===========================================================================
+// Implementation below
+//===========================================================================
+
+#include <cstring>
+
+template <class Fn>
+void ForEachLineInBlock(const char* begin, const char* end, Fn&& fn) {
+  while (begin != end) {
+    const char* p = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    if (p == nullptr) {
+      fn(begin, end);
+      return;
+    }
+    fn(begin, p);
+    begin = p + 1;
+  }
+}
 
 #endif  // GITHUB_ZISZIS_ZG_INPUT_INCLUDED
@@ -0,0 +1,159 @@
+#include "input.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+// next_in of z_stream is a pointer to const.
+#define ZLIB_CONST
+#include <zlib.h>
+
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Blocks read from a pipe which `data` is written into in small pieces.
+std::vector<std::string> ReadBlocksFromPipe(const std::string& data,
+                                            size_t min_block_size) {
+  int fds[2];
+  EXPECT_EQ(pipe(fds), 0);
+  std::thread writer([&] {
+    for (size_t i = 0; i < data.size(); i += 777) {
+      size_t n = std::min<size_t>(777, data.size() - i);
+      EXPECT_EQ(write(fds[1], data.data() + i, n), n);
+    }
+    close(fds[1]);
+  });
+  std::vector<std::string> blocks;
+  ForEachInputBlock(fds[0], min_block_size,
+                    [&](const char* begin, const char* end) {
+                      blocks.emplace_back(begin, end);
+                    });
+  writer.join();
+  close(fds[0]);
+  return blocks;
+}
+
+// Blocks read from a regular file with `data` in it.
+std::vector<std::string> ReadBlocksFromFile(const std::string& data,
+                                            size_t min_block_size) {
+  char path[] = "/tmp/input_test.XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_GE(fd, 0);
+  unlink(path);
+  EXPECT_EQ(write(fd, data.data(), data.size()), data.size());
+  lseek(fd, 0, SEEK_SET);
+  std::vector<std::string> blocks;
+  ForEachInputBlock(fd, min_block_size,
+                    [&](const char* begin, const char* end) {
+                      blocks.emplace_back(begin, end);
+                    });
+  close(fd);
+  return blocks;
+}
+
+// A gzip member with `data` in it.
+std::string Gzip(const std::string& data) {
+  z_stream z = {};
+  EXPECT_EQ(deflateInit2(&z, 1, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY),
+            Z_OK);
+  std::string result(deflateBound(&z, data.size()), '\0');
+  z.next_in = reinterpret_cast<const Bytef*>(data.data());
+  z.avail_in = data.size();
+  z.next_out = reinterpret_cast<Bytef*>(result.data());
+  z.avail_out = result.size();
+  EXPECT_EQ(deflate(&z, Z_FINISH), Z_STREAM_END);
+  result.resize(z.total_out);
+  deflateEnd(&z);
+  return result;
+}
+
+std::string Concat(const std::vector<std::string>& blocks) {
+  std::string result;
+  for (const std::string& block : blocks) result.append(block);
+  return result;
+}
+
+TEST(ForEachInputBlock, CutsPipedInputAtLines) {
+  std::string data;
+  for (int i = 0; i < 100000; ++i) {
+    data.append(std::to_string(i * 7919)).push_back('\n');
+  }
+  data.append("no newline at the end");
+  std::vector<std::string> blocks = ReadBlocksFromPipe(data, 4096);
+  EXPECT_GT(blocks.size(), 100);
+  for (size_t i = 0; i + 1 < blocks.size(); ++i) {
+    EXPECT_GE(blocks[i].size(), 4000);
+    EXPECT_EQ(blocks[i].back(), '\n');
+  }
+  EXPECT_EQ(Concat(blocks), data);
+}
+
+TEST(ForEachInputBlock, LinesLongerThanBlocks) {
+  std::string data = "short\n" + std::string(100000, 'x') + "\nshort\n" +
+                     std::string(5000, 'y');
+  std::vector<std::string> blocks = ReadBlocksFromPipe(data, 1024);
+  for (size_t i = 0; i + 1 < blocks.size(); ++i) {
+    EXPECT_EQ(blocks[i].back(), '\n');
+  }
+  EXPECT_EQ(Concat(blocks), data);
+
+  EXPECT_TRUE(ReadBlocksFromPipe("", 1024).empty());
+}
+
+TEST(ForEachInputBlock, ReadsFilesWithoutSize) {
+  EXPECT_TRUE(ReadBlocksFromFile("", 1024).empty());
+
+  // Reports a size of 0, like all of /proc.
+  int fd = open("/proc/self/status", O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(MappedFile::Map(fd), nullptr);
+  std::string data;
+  ForEachInputBlock(fd, 1024, [&](const char* begin, const char* end) {
+    data.append(begin, end);
+  });
+  close(fd);
+  EXPECT_NE(data.find("\nPid:"), std::string::npos);
+}
+
+TEST(ForEachInputBlock, DecompressesGzip) {
+  std::string first;
+  std::string second = std::string(50000, 'x') + "\n";
+  for (int i = 0; i < 100000; ++i) {
+    first.append(std::to_string(i * 7919)).push_back('\n');
+  }
+  // Two members, as `cat a.gz b.gz` makes.
+  std::string compressed = Gzip(first) + Gzip(second);
+  for (const auto& blocks : {ReadBlocksFromPipe(compressed, 4096),
+                             ReadBlocksFromFile(compressed, 4096)}) {
+    EXPECT_GT(blocks.size(), 100);
+    for (const std::string& block : blocks) EXPECT_EQ(block.back(), '\n');
+    EXPECT_EQ(Concat(blocks), first + second);
+  }
+  EXPECT_EQ(Concat(ReadBlocksFromFile(first, 4096)), first);
+}
+
+TEST(ForEachInputBlock, DecompressesGzipInChunks) {
+  std::string data;
+  for (int i = 0; i < 10000; ++i) {
+    data.append(std::to_string(i * 7919)).push_back('\n');
+  }
+  std::string compressed = Gzip(data) + Gzip(data);
+  // Chunk boundaries fall in the header, the deflate stream and the trailer
+  // of both members.
+  for (size_t chunk : {1, 3, 4096}) {
+    internal::max_gzip_chunk = chunk;
+    for (const auto& blocks : {ReadBlocksFromPipe(compressed, 4096),
+                               ReadBlocksFromFile(compressed, 4096)}) {
+      EXPECT_EQ(Concat(blocks), data + data) << chunk;
+    }
+  }
+  internal::max_gzip_chunk = std::numeric_limits<uInt>::max();
+}
+
+}  // namespace
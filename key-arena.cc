@@ -0,0 +1,22 @@
+#include "key-arena.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "base.h"
+
+namespace {
+constexpr size_t kChunkSize = 1 << 20;
+}  // namespace
+
+void KeyArena::NewChunk(size_t key_size) {
+  if (key_size > std::numeric_limits<uint32_t>::max()) {
+    Fail("Key too long, length=", key_size);
+  }
+  // Oversized keys get a chunk of their own.
+  size_t size = std::max(kChunkSize, kVarint32MaxLength + key_size);
+  chunks_.emplace_back(new char[size]);
+  pos_ = chunks_.back().get();
+  end_ = pos_ + size;
+  allocated_ += size;
+}
@@ -0,0 +1,45 @@
+#ifndef GITHUB_ZISZIS_ZG_KEY_ARENA_INCLUDED
+#define GITHUB_ZISZIS_ZG_KEY_ARENA_INCLUDED
+
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "varint.h"
+
+// Append-only storage for hash table keys. Every key is prefixed by its
+// varint-encoded length, so a single pointer is enough to refer to it. Keys
+// never move and are all released together with the arena.
+class KeyArena {
+ public:
+  // Copies `key` into the arena and returns its address for Load().
+  const char* Store(std::string_view key) {
+    if (static_cast<size_t>(end_ - pos_) < kVarint32MaxLength + key.size()) {
+      NewChunk(key.size());
+    }
+    const char* result = pos_;
+    pos_ = AppendVarint32(key.size(), pos_);
+    memcpy(pos_, key.data(), key.size());
+    pos_ += key.size();
+    return result;
+  }
+
+  static std::string_view Load(const char* key) {
+    uint32_t size = ParseVarint32(key);
+    return std::string_view(key, size);
+  }
+
+  // Bytes allocated for keys so far.
+  size_t MemoryUsage() const { return allocated_; }
+
+ private:
+  void NewChunk(size_t key_size);
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  char* pos_ = nullptr;
+  char* end_ = nullptr;
+  size_t allocated_ = 0;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_KEY_ARENA_INCLUDED
@@ -1,8 +1,10 @@
 #include "multi-aggregation.h"
 
 #include "composite-key.h"
+#include "dense-key.h"
 #include "no-keys.h"
-#include "single-key.h"
+#include "radix-key.h"
+#include "sorted-key.h"
 
 namespace {
 
@@ -35,6 +37,13 @@ class MultiAggregator {
   explicit MultiAggregator(std::vector<AggregatorField> fields)
       : fields_(std::move(fields)) {}
 
+  MultiAggregator(const MultiAggregator& other) {
+    for (const auto& f : other.fields_) {
+      fields_.push_back({f.aggregator->Clone(), f.state_offset});
+    }
+  }
+  MultiAggregator(MultiAggregator&&) = default;
+
   State Init(const InputRow& row) const {
     State state;
     for (const auto& f : fields_) {
@@ -49,6 +58,34 @@ class MultiAggregator {
     }
   }
 
+  // One virtual call per aggregator for the whole batch.
+  void UpdateBatch(Table::Batch rows, std::span<State* const> states) const {
+    state_ptrs_.clear();
+    for (State* state : states) state_ptrs_.push_back(&(*state)[0]);
+    for (const auto& f : fields_) {
+      f.aggregator->UpdateBatch(rows, state_ptrs_.data(), f.state_offset);
+    }
+  }
+
+  State Copy(const MultiAggregator& from, const State& from_state) const {
+    State state;
+    for (int i = 0; i < fields_.size(); ++i) {
+      size_t offset = fields_[i].state_offset;
+      fields_[i].aggregator->Copy(*from.fields_[i].aggregator,
+                                  &from_state[offset], &state[offset]);
+    }
+    return state;
+  }
+
+  void Merge(const MultiAggregator& from, const State& from_state,
+             State& state) const {
+    for (int i = 0; i < fields_.size(); ++i) {
+      size_t offset = fields_[i].state_offset;
+      fields_[i].aggregator->Merge(*from.fields_[i].aggregator,
+                                   &from_state[offset], &state[offset]);
+    }
+  }
+
   void Print(const State& state, OutputTable& out) const {
     for (const auto& f : fields_) {
       f.aggregator->Print(&state[f.state_offset], out);
@@ -61,8 +98,29 @@ class MultiAggregator {
     }
   }
 
+  void Save(const State& state, std::string* out) const {
+    for (const auto& f : fields_) {
+      f.aggregator->Save(&state[f.state_offset], out);
+    }
+  }
+
+  State Load(const char*& p) const {
+    State state;
+    for (const auto& f : fields_) {
+      f.aggregator->Load(p, &state[f.state_offset]);
+    }
+    return state;
+  }
+
+  size_t MemoryUsage() const {
+    size_t result = 0;
+    for (const auto& f : fields_) result += f.aggregator->MemoryUsage();
+    return result;
+  }
+
  private:
   std::vector<AggregatorField> fields_;
+  mutable std::vector<char*> state_ptrs_;  // UpdateBatch() scratch space.
 };
 
 std::pair<size_t, std::vector<AggregatorField>> LayoutAggregatorState(
@@ -88,16 +146,24 @@ std::pair<size_t, std::vector<AggregatorField>> LayoutAggregatorState(
 template <class Aggregator>
 std::unique_ptr<Table> MakeMultiAggregatorTable(
     Aggregator aggregator, std::vector<Table::Key> keys,
-    std::unique_ptr<OutputTable> output) {
+    std::unique_ptr<OutputTable> output, const AggregationOptions& options) {
   if (keys.size() == 0) {
     return std::make_unique<NoKeyTable<Aggregator>>(std::move(aggregator),
                                                     std::move(output));
+  } else if (options.sorted) {
+    return std::make_unique<SortedKeyTable<Aggregator>>(
+        std::move(keys), std::move(aggregator), std::move(output));
+  } else if (options.sort_by_hash) {
+    return std::make_unique<RadixKeyTable<Aggregator>>(
+        std::move(keys), std::move(aggregator), std::move(output),
+        options.threads);
   } else if (keys.size() == 1) {
-    return std::make_unique<SingleKeyTable<Aggregator>>(
-        keys[0], std::move(aggregator), std::move(output));
+    return std::make_unique<DenseKeyTable<Aggregator>>(
+        keys[0], std::move(aggregator), std::move(output),
+        options.max_memory);
   } else {
-    return std::make_unique<CompositeKeyTable<Aggregator>>(
-        std::move(keys), std::move(aggregator), std::move(output));
+    return MakeCompositeKeyTable(std::move(keys), std::move(aggregator),
+                                 std::move(output), options.max_memory);
   }
 }
 
@@ -106,27 +172,37 @@ std::unique_ptr<Table> MakeMultiAggregatorTable(
 std::unique_ptr<Table> MakeMultiAggregatorTable(
     std::vector<Table::Key> keys,
     std::vector<std::unique_ptr<AggregatorInterface>> aggregators,
-    std::unique_ptr<OutputTable> output) {
+    std::unique_ptr<OutputTable> output, const AggregationOptions& options) {
   auto [total_size, fields] = LayoutAggregatorState(std::move(aggregators));
 
   if (total_size <= 8) {
     return MakeMultiAggregatorTable(MultiAggregator<8>(std::move(fields)),
-                                    std::move(keys), std::move(output));
+                                    std::move(keys), std::move(output),
+                                    options);
   } else if (total_size <= 16) {
     return MakeMultiAggregatorTable(MultiAggregator<16>(std::move(fields)),
-                                    std::move(keys), std::move(output));
+                                    std::move(keys), std::move(output),
+                                    options);
   } else if (total_size <= 24) {
     return MakeMultiAggregatorTable(MultiAggregator<24>(std::move(fields)),
-                                    std::move(keys), std::move(output));
+                                    std::move(keys), std::move(output),
+                                    options);
   } else if (total_size <= 32) {
     return MakeMultiAggregatorTable(MultiAggregator<32>(std::move(fields)),
-                                    std::move(keys), std::move(output));
+                                    std::move(keys), std::move(output),
+                                    options);
   } else if (total_size <= 48) {
     return MakeMultiAggregatorTable(MultiAggregator<48>(std::move(fields)),
-                                    std::move(keys), std::move(output));
+                                    std::move(keys), std::move(output),
+                                    options);
   } else if (total_size <= 64) {
     return MakeMultiAggregatorTable(MultiAggregator<64>(std::move(fields)),
-                                    std::move(keys), std::move(output));
+                                    std::move(keys), std::move(output),
+                                    options);
+  } else if (total_size <= 96) {
+    return MakeMultiAggregatorTable(MultiAggregator<96>(std::move(fields)),
+                                    std::move(keys), std::move(output),
+                                    options);
   } else {
     Fail("Too much state");  // Add more branches.
   }
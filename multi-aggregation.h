@@ -2,6 +2,7 @@
 #define GITHUB_ZISZIS_ZG_MULTI_AGGREGATION_INCLUDED
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "base.h"
@@ -17,8 +18,23 @@ class AggregatorInterface {
   virtual size_t StateAlign() const = 0;
   virtual void Init(const InputRow& row, char* state) = 0;
   virtual void Update(const InputRow& row, char* state) = 0;
+  // Updates states[i] + offset with rows[i].
+  virtual void UpdateBatch(Table::Batch rows, char* const* states,
+                           size_t offset) = 0;
   virtual void Print(const char* state, OutputTable&) const = 0;
   virtual void Reset() = 0;
+
+  // Parallel aggregation support: `from` is always a clone of this aggregator.
+  virtual std::unique_ptr<AggregatorInterface> Clone() const = 0;
+  virtual void Copy(const AggregatorInterface& from, const char* from_state,
+                    char* state) = 0;
+  virtual void Merge(const AggregatorInterface& from, const char* from_state,
+                     char* state) = 0;
+
+  // Spilling support (see spill.h).
+  virtual void Save(const char* state, std::string* out) const = 0;
+  virtual void Load(const char*& p, char* state) = 0;
+  virtual size_t MemoryUsage() const = 0;
 };
 
 template <class A>
@@ -27,7 +43,7 @@ std::unique_ptr<AggregatorInterface> TypeErasedAggregator(A a);
 std::unique_ptr<Table> MakeMultiAggregatorTable(
     std::vector<Table::Key> keys,
     std::vector<std::unique_ptr<AggregatorInterface>> aggregated_fields,
-    std::unique_ptr<OutputTable> output);
+    std::unique_ptr<OutputTable> output, const AggregationOptions& options);
 
 //===========================================================================
 // Implementation below
@@ -49,11 +65,40 @@ class AggregatorWrapper : public AggregatorInterface {
   void Update(const InputRow& row, char* state) override {
     a_.Update(row, *reinterpret_cast<State*>(state));
   }
+  void UpdateBatch(Table::Batch rows, char* const* states,
+                   size_t offset) override {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      a_.Update(*rows[i], *reinterpret_cast<State*>(states[i] + offset));
+    }
+  }
   void Print(const char* state, OutputTable& out) const override {
     a_.Print(*reinterpret_cast<const State*>(state), out);
   }
   void Reset() override { a_.Reset(); }
 
+  std::unique_ptr<AggregatorInterface> Clone() const override {
+    return std::make_unique<AggregatorWrapper>(a_);
+  }
+  void Copy(const AggregatorInterface& from, const char* from_state,
+            char* state) override {
+    new (state) State(a_.Copy(static_cast<const AggregatorWrapper&>(from).a_,
+                              *reinterpret_cast<const State*>(from_state)));
+  }
+  void Merge(const AggregatorInterface& from, const char* from_state,
+             char* state) override {
+    a_.Merge(static_cast<const AggregatorWrapper&>(from).a_,
+             *reinterpret_cast<const State*>(from_state),
+             *reinterpret_cast<State*>(state));
+  }
+
+  void Save(const char* state, std::string* out) const override {
+    a_.Save(*reinterpret_cast<const State*>(state), out);
+  }
+  void Load(const char*& p, char* state) override {
+    new (state) State(a_.Load(p));
+  }
+  size_t MemoryUsage() const override { return a_.MemoryUsage(); }
+
  private:
   A a_;
 };
@@ -2,6 +2,7 @@
 #define GITHUB_ZISZIS_ZG_NO_KEY_INCLUDED
 
 #include <optional>
+#include <vector>
 
 #include "table.h"
 
@@ -19,6 +20,32 @@ class NoKeyTable : public Table {
     }
   }
 
+  void PushBatch(Batch rows) override {
+    if (rows.empty()) return;
+    if (!value_) {
+      value_ = aggregator_.Init(*rows[0]);
+      rows = rows.subspan(1);
+    }
+    states_.assign(rows.size(), &*value_);
+    UpdateBatch(aggregator_, rows, std::span<State* const>(states_));
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<NoKeyTable>(aggregator_, nullptr);
+  }
+
+  void Merge(Table& fork) override {
+    auto& that = static_cast<NoKeyTable&>(fork);
+    if (!that.value_) return;
+    if (value_) {
+      aggregator_.Merge(that.aggregator_, *that.value_, *value_);
+    } else {
+      value_ = aggregator_.Copy(that.aggregator_, *that.value_);
+    }
+    that.value_.reset();
+    that.aggregator_.Reset();
+  }
+
   void Finish() override {
     if (value_) {
       aggregator_.Print(*value_, *output_);
@@ -32,9 +59,12 @@ class NoKeyTable : public Table {
   }
 
  private:
-  std::optional<typename Aggregator::State> value_;
+  using State = typename Aggregator::State;
+
+  std::optional<State> value_;
   Aggregator aggregator_;
   std::unique_ptr<OutputTable> output_;
+  std::vector<State*> states_;  // PushBatch() scratch space.
 };
 
 #endif  // GITHUB_ZISZIS_ZG_NO_KEY_INCLUDED
@@ -0,0 +1,101 @@
+#include "options.h"
+
+#include <glob.h>
+
+#include <algorithm>
+#include <limits>
+#include <string_view>
+#include <thread>
+
+#include "absl/strings/numbers.h"
+#include "base.h"
+
+namespace {
+
+int ParseThreads(std::string_view flag, std::string_view value) {
+  int result;
+  if (!absl::SimpleAtoi(value, &result) || result < 0) {
+    Fail("Invalid value of ", flag, ": ", Quoted(value));
+  }
+  if (result == 0) result = std::max(1u, std::thread::hardware_concurrency());
+  return result;
+}
+
+// A number of bytes, optionally followed by K, M or G (powers of 1024).
+size_t ParseBytes(std::string_view flag, std::string_view value) {
+  size_t multiplier = 1;
+  if (!value.empty()) {
+    switch (value.back()) {
+      case 'K': multiplier = size_t{1} << 10; break;
+      case 'M': multiplier = size_t{1} << 20; break;
+      case 'G': multiplier = size_t{1} << 30; break;
+    }
+  }
+  std::string_view number =
+      multiplier == 1 ? value : value.substr(0, value.size() - 1);
+  uint64_t result;
+  if (!absl::SimpleAtoi(number, &result) ||
+      result > std::numeric_limits<size_t>::max() / multiplier) {
+    Fail("Invalid value of ", flag, ": ", Quoted(value));
+  }
+  return result * multiplier;
+}
+
+// Files matching a glob pattern, or the pattern itself if none does (so
+// that opening it fails with a proper error).
+void AddInputs(std::string_view pattern, std::vector<std::string>* inputs) {
+  if (pattern.empty()) Fail("--input needs a file name");
+  std::string p(pattern);
+  glob_t matches;
+  if (glob(p.c_str(), GLOB_NOCHECK, nullptr, &matches) != 0) {
+    globfree(&matches);
+    Fail("Cannot expand ", Quoted(pattern));
+  }
+  inputs->insert(inputs->end(), matches.gl_pathv,
+                 matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+}
+
+}  // namespace
+
+std::vector<std::string> ParseOptions(int argc, char* argv[],
+                                      Options* options) {
+  std::vector<std::string> spec;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (!arg.starts_with("--")) {
+      spec.emplace_back(arg);
+      continue;
+    }
+    size_t eq = arg.find('=');
+    std::string_view flag = arg.substr(0, eq);
+    std::string_view value =
+        eq == arg.npos ? std::string_view() : arg.substr(eq + 1);
+    if (flag == "--threads") {
+      options->threads = ParseThreads(flag, value);
+    } else if (flag == "--partitions") {
+      options->partitions = ParseThreads(flag, value);
+    } else if (flag == "--sorted") {
+      if (!value.empty()) Fail(flag, " takes no value");
+      options->sorted = true;
+    } else if (flag == "--max-memory") {
+      options->max_memory = ParseBytes(flag, value);
+    } else if (flag == "--engine") {
+      if (value == "hash") {
+        options->engine = Options::Engine::kHash;
+      } else if (value == "sort") {
+        options->engine = Options::Engine::kSort;
+      } else {
+        Fail("Invalid value of ", flag, ": ", Quoted(value));
+      }
+    } else if (flag == "--stage-threads") {
+      if (!value.empty()) Fail(flag, " takes no value");
+      options->stage_threads = true;
+    } else if (flag == "--input") {
+      AddInputs(value, &options->inputs);
+    } else {
+      Fail("Unknown flag: ", flag);
+    }
+  }
+  return spec;
+}
@@ -0,0 +1,51 @@
+#ifndef GITHUB_ZISZIS_ZG_OPTIONS_INCLUDED
+#define GITHUB_ZISZIS_ZG_OPTIONS_INCLUDED
+
+#include <string>
+#include <vector>
+
+// Command-line flags. Unlike spec.h, which describes what to compute, these
+// only affect how it's computed.
+struct Options {
+  // Number of threads aggregating the input (0 means one per core). Blocks
+  // of lines go to whichever thread is free, so min/max with output columns
+  // may pick a different one of several rows with the same value from run
+  // to run.
+  int threads = 1;
+
+  // If above 1, keyed aggregation at the first stage is partitioned by key
+  // hash between that many threads (see partitioned.h). Rows are routed to
+  // them by a single thread, so this doesn't go with `threads`.
+  int partitions = 0;
+
+  // The input is sorted by the keys of the first stage, which then
+  // aggregates one group at a time (see sorted-key.h). Disables threads and
+  // partitions for that stage.
+  bool sorted = false;
+
+  // Memory budget (in bytes) for the groups of each aggregating stage, past
+  // which they're spilled to temporary files (see spill.h). 0 means no
+  // limit. At the first stage it's shared by all threads or partitions.
+  size_t max_memory = 0;
+
+  // How keyed stages find groups: kHash looks every row up in a hash table,
+  // kSort sorts all rows by key hash at the end (see radix-key.h). The sort
+  // engine keeps every row in memory, so with max_memory the hash engine is
+  // used instead.
+  enum class Engine { kHash, kSort };
+  Engine engine = Engine::kHash;
+
+  // Every stage after the first runs on a thread of its own, taking lines
+  // from the previous one through a queue (see stage-thread.h).
+  bool stage_threads = false;
+
+  // Files to read instead of stdin, in parallel (see parallel.h). --input
+  // may be repeated, and takes glob patterns.
+  std::vector<std::string> inputs;
+};
+
+// Extracts --flag=value arguments from argv into `options`, returns the
+// remaining arguments (i.e. the spec).
+std::vector<std::string> ParseOptions(int argc, char* argv[], Options* options);
+
+#endif  // GITHUB_ZISZIS_ZG_OPTIONS_INCLUDED
@@ -0,0 +1,119 @@
+#include "ordered-output.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace {
+
+class OrderedOutputTable : public OutputTable {
+ public:
+  OrderedOutputTable(int num_columns, int column, bool descending,
+                     size_t limit, std::unique_ptr<OutputTable> output)
+      : OutputTable(num_columns),
+        column_(column),
+        descending_(descending),
+        limit_(limit),
+        output_(std::move(output)) {}
+
+  void EndLine() override {
+    Numeric value = is_number_[column_]
+                        ? numbers_[column_]
+                        : Numeric::Make(FieldValue(columns_[column_]));
+    if (limit_ == 0 || lines_.size() < limit_) {
+      lines_.push_back(Line{.value = value, .seq = seq_++});
+      Save(lines_.back().data);
+      if (limit_ != 0) std::push_heap(lines_.begin(), lines_.end(), Before());
+      return;
+    }
+    Line& last = lines_.front();
+    // Comes after the last line kept, as its sequence number is larger.
+    if (!(descending_ ? last.value < value : value < last.value)) {
+      ++seq_;
+      return;
+    }
+    std::pop_heap(lines_.begin(), lines_.end(), Before());
+    lines_.back().value = value;
+    lines_.back().seq = seq_++;
+    Save(lines_.back().data);
+    std::push_heap(lines_.begin(), lines_.end(), Before());
+  }
+
+  void Finish() override {
+    if (limit_ == 0) {
+      std::sort(lines_.begin(), lines_.end(), Before());
+    } else {
+      std::sort_heap(lines_.begin(), lines_.end(), Before());
+    }
+    for (const Line& line : lines_) {
+      const char* p = line.data.data();
+      for (int i = 0; i < columns_.size(); ++i) {
+        if (*p++) {
+          output_->SetNumber(i, Numeric::Load(p));
+        } else {
+          uint32_t n;
+          memcpy(&n, p, sizeof(n));
+          output_->Set(i, std::string_view(p + sizeof(n), n));
+          p += sizeof(n) + n;
+        }
+      }
+      output_->EndLine();
+    }
+    decltype(lines_)().swap(lines_);
+    output_->Finish();
+  }
+
+ private:
+  struct Line {
+    Numeric value;
+    uint64_t seq;
+    std::string data;
+  };
+
+  // Whether line `a` goes out before line `b`.
+  struct LineOrder {
+    bool operator()(const Line& a, const Line& b) const {
+      if (descending ? b.value < a.value : a.value < b.value) return true;
+      if (descending ? a.value < b.value : b.value < a.value) return false;
+      return a.seq < b.seq;
+    }
+    bool descending;
+  };
+  LineOrder Before() const { return {descending_}; }
+
+  // Every column is a flag telling whether it's a number, followed by the
+  // saved number, or the size and contents of its text.
+  void Save(std::string& data) const {
+    data.clear();
+    for (int i = 0; i < columns_.size(); ++i) {
+      data.push_back(is_number_[i]);
+      if (is_number_[i]) {
+        numbers_[i].Save(&data);
+      } else {
+        uint32_t n = columns_[i].size();
+        data.append(reinterpret_cast<const char*>(&n), sizeof(n));
+        data.append(columns_[i]);
+      }
+    }
+  }
+
+  int column_;
+  bool descending_;
+  size_t limit_;
+  std::unique_ptr<OutputTable> output_;
+  uint64_t seq_ = 0;
+  // Lines kept so far; a heap with the last line on top if limit_ != 0.
+  std::vector<Line> lines_;
+};
+
+}  // namespace
+
+std::unique_ptr<OutputTable> MakeOrderedOutputTable(
+    int num_columns, int column, bool descending, size_t limit,
+    std::unique_ptr<OutputTable> output) {
+  return std::make_unique<OrderedOutputTable>(num_columns, column, descending,
+                                              limit, std::move(output));
+}
@@ -0,0 +1,20 @@
+#ifndef GITHUB_ZISZIS_ZG_ORDERED_OUTPUT_INCLUDED
+#define GITHUB_ZISZIS_ZG_ORDERED_OUTPUT_INCLUDED
+
+#include <memory>
+
+#include "output.h"
+
+// Passes lines on to `output` in order of the numeric value of `column`
+// (see Numeric), ascending or `descending`, lines with equal values in the
+// order they came in. Nothing is passed on before Finish().
+//
+// If `limit` is non-zero only the first `limit` lines are kept, in a heap
+// whose last line is at its top: a line which wouldn't make it is dropped
+// after parsing a single column, and the others replace the last line in
+// O(log limit). Every line is kept otherwise.
+std::unique_ptr<OutputTable> MakeOrderedOutputTable(
+    int num_columns, int column, bool descending, size_t limit,
+    std::unique_ptr<OutputTable> output);
+
+#endif  // GITHUB_ZISZIS_ZG_ORDERED_OUTPUT_INCLUDED
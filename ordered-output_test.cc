@@ -0,0 +1,85 @@
+#include "ordered-output.h"
+
+#include <random>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Collects lines of two columns as tab-separated strings.
+class CollectingTable : public OutputTable {
+ public:
+  explicit CollectingTable(std::vector<std::string>* lines)
+      : OutputTable(2), lines_(lines) {}
+  void EndLine() override {
+    lines_->push_back(absl::StrCat(Text(0), "\t", Text(1)));
+  }
+  void Finish() override {}
+
+ private:
+  std::vector<std::string>* lines_;
+};
+
+std::vector<std::string> Order(
+    const std::vector<std::pair<std::string, std::string>>& lines,
+    bool descending, size_t limit) {
+  std::vector<std::string> result;
+  std::unique_ptr<OutputTable> table = MakeOrderedOutputTable(
+      2, 1, descending, limit, std::make_unique<CollectingTable>(&result));
+  for (const auto& [key, value] : lines) {
+    table->Set(0, key);
+    table->Set(1, value);
+    table->EndLine();
+  }
+  EXPECT_TRUE(result.empty());
+  table->Finish();
+  return result;
+}
+
+TEST(OrderedOutputTable, Sorts) {
+  std::vector<std::pair<std::string, std::string>> lines = {
+      {"a", "10"}, {"b", "9"}, {"c", "-1.5"}, {"d", "10"}, {"e", "1e2"}};
+  using Lines = std::vector<std::string>;
+  EXPECT_EQ(Order(lines, false, 0),
+            (Lines{"c\t-1.5", "b\t9", "a\t10", "d\t10", "e\t1e2"}));
+  EXPECT_EQ(Order(lines, true, 0),
+            (Lines{"e\t1e2", "a\t10", "d\t10", "b\t9", "c\t-1.5"}));
+  // Ties are kept in the order lines came in.
+  EXPECT_EQ(Order(lines, true, 3), (Lines{"e\t1e2", "a\t10", "d\t10"}));
+  EXPECT_EQ(Order(lines, false, 2), (Lines{"c\t-1.5", "b\t9"}));
+  EXPECT_EQ(Order(lines, false, 100), Order(lines, false, 0));
+  EXPECT_EQ(Order({}, false, 1), Lines{});
+}
+
+TEST(OrderedOutputTable, SortsNumbers) {
+  std::vector<std::string> result;
+  std::unique_ptr<OutputTable> table = MakeOrderedOutputTable(
+      2, 0, false, 2, std::make_unique<CollectingTable>(&result));
+  table->SetNumber(0, Numeric(2.5));
+  table->Set(1, "a");
+  table->EndLine();
+  table->Set(0, "2");
+  table->SetNumber(1, Numeric(int64_t{7}));
+  table->EndLine();
+  table->SetNumber(0, Numeric(int64_t{3}));
+  table->Set(1, "c");
+  table->EndLine();
+  table->Finish();
+  EXPECT_EQ(result, (std::vector<std::string>{"2\t7", "2.5\ta"}));
+}
+
+TEST(OrderedOutputTable, KeepsTopLines) {
+  std::mt19937_64 e(42);
+  std::vector<std::pair<std::string, std::string>> lines;
+  for (int i = 0; i < 100000; ++i) {
+    lines.emplace_back(absl::StrCat("key", i), absl::StrCat(e() % 1000));
+  }
+  std::vector<std::string> all = Order(lines, true, 0);
+  for (size_t limit : {1, 10, 1000}) {
+    std::vector<std::string> top = Order(lines, true, limit);
+    EXPECT_EQ(top, std::vector<std::string>(all.begin(), all.begin() + limit));
+  }
+}
+
+}  // namespace
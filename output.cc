@@ -31,8 +31,12 @@ class StdoutOutputTable : public OutputTable {
 
   void EndLine() override {
     std::string& buf = buf_.buf();
-    for (auto c : columns_) {
-      buf.append(c);
+    for (int i = 0; i < columns_.size(); ++i) {
+      if (is_number_[i]) {
+        numbers_[i].Print(&buf);
+      } else {
+        buf.append(columns_[i]);
+      }
       buf.push_back('\t');
     }
     buf.back() = '\n';
@@ -47,11 +51,12 @@ class StdoutOutputTable : public OutputTable {
 
 class PipeOutputTable : public OutputTable {
  public:
-  PipeOutputTable(int num_columns, std::unique_ptr<Table> table)
-      : OutputTable(num_columns), table_(std::move(table)) {}
+  PipeOutputTable(int num_columns, std::unique_ptr<Table> table,
+                  int max_field)
+      : OutputTable(num_columns), table_(std::move(table)), row_(max_field) {}
 
   void EndLine() override {
-    row_.Reset(columns_);
+    row_.Reset(columns_, numbers_, is_number_);
     table_->PushRow(row_);
   }
 
@@ -62,6 +67,30 @@ class PipeOutputTable : public OutputTable {
   InputRow row_;
 };
 
+class ForwardingOutputTable : public OutputTable {
+ public:
+  ForwardingOutputTable(int num_columns, OutputTable* target)
+      : OutputTable(num_columns), target_(target) {}
+
+  void EndLine() override {
+    for (int i = 0; i < columns_.size(); ++i) {
+      if (is_number_[i]) {
+        target_->SetNumber(i, numbers_[i]);
+      } else {
+        target_->Set(i, columns_[i]);
+      }
+    }
+    target_->EndLine();
+  }
+
+  void Finish() override {}
+
+  OutputTable* target() const { return target_; }
+
+ private:
+  OutputTable* target_;
+};
+
 class PassthroughTable : public Table {
  public:
   void PushRow(const InputRow& row) override {
@@ -77,13 +106,32 @@ class PassthroughTable : public Table {
 
 }  // namespace
 
+std::string_view OutputTable::Text(int column) {
+  if (!is_number_[column]) return columns_[column];
+  if (text_.empty()) text_.resize(columns_.size());
+  text_[column].clear();
+  numbers_[column].Print(&text_[column]);
+  return text_[column];
+}
+
 std::unique_ptr<OutputTable> MakeStdoutTable(int num_columns) {
   return std::make_unique<StdoutOutputTable>(num_columns);
 }
 
 std::unique_ptr<OutputTable> MakePipeTable(int num_columns,
-                                           std::unique_ptr<Table> table) {
-  return std::make_unique<PipeOutputTable>(num_columns, std::move(table));
+                                           std::unique_ptr<Table> table,
+                                           int max_field) {
+  return std::make_unique<PipeOutputTable>(num_columns, std::move(table),
+                                           max_field);
+}
+
+std::unique_ptr<OutputTable> MakeForwardingTable(int num_columns,
+                                                 OutputTable* target) {
+  // Forwarding to a forwarding table would copy every line twice.
+  if (auto* forwarding = dynamic_cast<ForwardingOutputTable*>(target)) {
+    target = forwarding->target();
+  }
+  return std::make_unique<ForwardingOutputTable>(num_columns, target);
 }
 
 std::unique_ptr<Table> MakePassthroughTable() {
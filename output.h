@@ -6,24 +6,52 @@
 #include <vector>
 
 #include "table.h"
+#include "types.h"
 
 class OutputTable {
  public:
-  explicit OutputTable(int num_columns) : columns_(num_columns) {}
+  explicit OutputTable(int num_columns)
+      : columns_(num_columns), numbers_(num_columns), is_number_(num_columns) {}
   virtual ~OutputTable() {}
 
-  void Set(int column, std::string_view value) { columns_[column] = value; }
+  int num_columns() const { return columns_.size(); }
+  void Set(int column, std::string_view value) {
+    columns_[column] = value;
+    is_number_[column] = false;
+  }
+  // Numbers go to the next stage as they are (see InputRow::Number()), and
+  // are only formatted when printed.
+  void SetNumber(int column, Numeric value) {
+    numbers_[column] = value;
+    is_number_[column] = true;
+  }
   virtual void EndLine() = 0;
   virtual void Finish() = 0;
 
  protected:
+  // Text of a column, whether it was set as text or as a number.
+  std::string_view Text(int column);
+
+  // columns_[i] is only valid unless is_number_[i], numbers_[i] otherwise.
   std::vector<std::string_view> columns_;
+  std::vector<Numeric> numbers_;
+  std::vector<char> is_number_;
+
+ private:
+  std::vector<std::string> text_;
 };
 
 std::unique_ptr<OutputTable> MakeStdoutTable(int num_columns);
 
+// `max_field` is the highest column index `table` accesses (see InputRow).
 std::unique_ptr<OutputTable> MakePipeTable(int num_columns,
-                                           std::unique_ptr<Table> table);
+                                           std::unique_ptr<Table> table,
+                                           int max_field);
+
+// Forwards lines to `target`, which must outlive the returned table. Finish()
+// does nothing: finishing `target` is up to its owner.
+std::unique_ptr<OutputTable> MakeForwardingTable(int num_columns,
+                                                 OutputTable* target);
 
 std::unique_ptr<Table> MakePassthroughTable();
 
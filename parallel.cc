@@ -0,0 +1,222 @@
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base.h"
+#include "block-queue.h"
+#include "input.h"
+#include "row-batch.h"
+
+namespace {
+
+constexpr size_t kBlockSize = 1 << 20;
+
+// Workers cut blocks off the mapped file themselves, no copying involved.
+void ScanMapped(std::string_view data, int max_field,
+                const std::vector<Table*>& tables) {
+  std::mutex mu;
+  std::vector<std::thread> workers;
+  for (Table* t : tables) {
+    workers.emplace_back([&, t] {
+      RowBatcher batcher(max_field);
+      while (true) {
+        std::string_view block;
+        {
+          std::lock_guard lock(mu);
+          block = CutBlock(&data, kBlockSize);
+        }
+        if (block.empty()) return;
+        batcher.PushLines(block.data(), block.data() + block.size(), *t);
+      }
+    });
+  }
+  for (auto& w : workers) w.join();
+}
+
+// Blocks are read by this thread and copied into the queue.
+void ScanStream(int fd, std::string_view file, int max_field,
+                const std::vector<Table*>& tables) {
+  BlockQueue queue(2 * tables.size());
+  std::vector<std::thread> workers;
+  for (Table* t : tables) {
+    workers.emplace_back([&queue, file, max_field, t] {
+      RowBatcher batcher(max_field);
+      batcher.SetFile(file);
+      std::string block;
+      while (queue.Pop(&block)) {
+        batcher.PushLines(block.data(), block.data() + block.size(), *t);
+        queue.Release(std::move(block));
+      }
+    });
+  }
+  ForEachInputBlock(fd, kBlockSize, [&](const char* begin, const char* end) {
+    std::string block = queue.Acquire();
+    block.assign(begin, end);
+    queue.Push(std::move(block));
+  });
+  queue.Close();
+  for (auto& w : workers) w.join();
+}
+
+// An input file, see PushFilesInParallel().
+struct Source {
+  std::string_view name;
+  int fd = -1;
+  // Null unless the file is mapped and not compressed.
+  std::unique_ptr<MappedFile> mapped;
+  // What's left to cut blocks off.
+  std::string_view data;
+};
+
+void ScanFiles(std::vector<Source>& sources, int max_field,
+               const std::vector<Table*>& tables) {
+  std::mutex mu;
+  size_t next = 0;  // First source no thread took yet.
+  std::vector<std::thread> workers;
+  for (Table* t : tables) {
+    workers.emplace_back([&, t] {
+      RowBatcher batcher(max_field);
+      Source* source = nullptr;
+      while (true) {
+        std::string_view block;
+        {
+          std::lock_guard lock(mu);
+          if (source == nullptr || source->data.empty()) {
+            source = nullptr;
+            if (next < sources.size()) {
+              source = &sources[next++];
+            } else {
+              for (Source& s : sources) {
+                if (source == nullptr || s.data.size() > source->data.size()) {
+                  source = &s;
+                }
+              }
+              if (source == nullptr || source->data.empty()) return;
+            }
+          }
+          if (source->mapped) block = CutBlock(&source->data, kBlockSize);
+        }
+        batcher.SetFile(source->name);
+        if (source->mapped) {
+          batcher.PushLines(block.data(), block.data() + block.size(), *t);
+        } else {
+          ForEachInputBlock(source->fd, kBlockSize,
+                            [&](const char* begin, const char* end) {
+                              batcher.PushLines(begin, end, *t);
+                            });
+          source = nullptr;
+        }
+      }
+    });
+  }
+  for (auto& w : workers) w.join();
+}
+
+// Merges all tables into tables[0], pairwise in parallel.
+void MergeAll(const std::vector<Table*>& tables) {
+  for (size_t step = 1; step < tables.size(); step *= 2) {
+    std::vector<std::thread> mergers;
+    for (size_t i = 0; i + step < tables.size(); i += 2 * step) {
+      mergers.emplace_back(
+          [&tables, i, step] { tables[i]->Merge(*tables[i + step]); });
+    }
+    for (auto& t : mergers) t.join();
+  }
+}
+
+// Forks of `table` for all threads but the first one, none if the table
+// can't be forked.
+std::vector<std::unique_ptr<Table>> ForkTable(Table& table, int num_threads) {
+  std::vector<std::unique_ptr<Table>> forks;
+  for (int i = 1; i < num_threads; ++i) {
+    forks.push_back(table.Fork());
+    if (forks.back() == nullptr) {
+      forks.clear();
+      break;
+    }
+  }
+  return forks;
+}
+
+}  // namespace
+
+void PushInputInParallel(int num_threads, int fd, int max_field,
+                         Table& table) {
+  std::vector<std::unique_ptr<Table>> forks = ForkTable(table, num_threads);
+  if (forks.empty()) {
+    RowBatcher batcher(max_field);
+    ForEachInputBlock(fd, kBlockSize, [&](const char* begin, const char* end) {
+      batcher.PushLines(begin, end, table);
+    });
+    return;
+  }
+
+  // `table` itself is aggregated into by the first worker.
+  std::vector<Table*> tables = {&table};
+  for (const auto& fork : forks) tables.push_back(fork.get());
+
+  std::unique_ptr<MappedFile> mapped = MappedFile::Map(fd);
+  if (mapped && !IsCompressedInput(*mapped)) {
+    ScanMapped(mapped->contents(), max_field, tables);
+  } else {
+    mapped.reset();
+    ScanStream(fd, "", max_field, tables);
+  }
+  MergeAll(tables);
+}
+
+void PushFilesInParallel(int num_threads, const std::vector<std::string>& files,
+                         int max_field, Table& table) {
+  std::vector<Source> sources(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    Source& source = sources[i];
+    source.name = files[i];
+    source.fd = open(files[i].c_str(), O_RDONLY);
+    if (source.fd < 0) {
+      Fail("Cannot open ", Quoted(files[i]), ": ", std::strerror(errno));
+    }
+  }
+
+  std::vector<std::unique_ptr<Table>> forks = ForkTable(table, num_threads);
+  if (forks.empty()) {
+    RowBatcher batcher(max_field);
+    for (Source& source : sources) {
+      batcher.SetFile(source.name);
+      ForEachInputBlock(source.fd, kBlockSize,
+                        [&](const char* begin, const char* end) {
+                          batcher.PushLines(begin, end, table);
+                        });
+    }
+  } else {
+    std::vector<Table*> tables = {&table};
+    for (const auto& fork : forks) tables.push_back(fork.get());
+    for (Source& source : sources) {
+      source.mapped = MappedFile::Map(source.fd);
+      if (source.mapped && IsCompressedInput(*source.mapped)) {
+        source.mapped.reset();
+      }
+      if (source.mapped) source.data = source.mapped->contents();
+    }
+    // A lone stream is better shared by all threads than read by one.
+    if (sources.size() == 1 && !sources[0].mapped) {
+      ScanStream(sources[0].fd, sources[0].name, max_field, tables);
+    } else {
+      ScanFiles(sources, max_field, tables);
+    }
+    MergeAll(tables);
+  }
+
+  for (Source& source : sources) {
+    source.mapped.reset();
+    close(source.fd);
+  }
+}
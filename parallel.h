@@ -0,0 +1,27 @@
+#ifndef GITHUB_ZISZIS_ZG_PARALLEL_INCLUDED
+#define GITHUB_ZISZIS_ZG_PARALLEL_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "table.h"
+
+// Pushes all lines read from `fd` into `table` using `num_threads` threads.
+// Blocks of lines are handed to workers, each one aggregating into its own
+// Table::Fork(); forks are merged back into `table` at the end. Falls back to
+// a plain single-threaded loop if the table can't be forked.
+//
+// `max_field` is the highest field index `table` accesses (see InputRow).
+void PushInputInParallel(int num_threads, int fd, int max_field, Table& table);
+
+// Same for all lines of `files`, which are scanned at once. Each thread
+// starts on a file of its own, cutting blocks off it if it can be mapped.
+// Once no file is left to start, threads take blocks off the mapped file with
+// most left to scan, so that a large file is finished by all of them.
+// Compressed files are read through by the thread which took them.
+//
+// Rows carry the name of their file (see InputRow::SetFile()).
+void PushFilesInParallel(int num_threads, const std::vector<std::string>& files,
+                         int max_field, Table& table);
+
+#endif  // GITHUB_ZISZIS_ZG_PARALLEL_INCLUDED
@@ -0,0 +1,237 @@
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+// next_in of z_stream is a pointer to const.
+#define ZLIB_CONST
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "aggregators.h"
+#include "composite-key.h"
+#include "dense-key.h"
+#include "gtest/gtest.h"
+#include "output.h"
+
+namespace {
+
+// A gzip member with `data` in it.
+std::string Gzip(const std::string& data) {
+  z_stream z = {};
+  EXPECT_EQ(deflateInit2(&z, 1, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY),
+            Z_OK);
+  std::string result(deflateBound(&z, data.size()), '\0');
+  z.next_in = reinterpret_cast<const Bytef*>(data.data());
+  z.avail_in = data.size();
+  z.next_out = reinterpret_cast<Bytef*>(result.data());
+  z.avail_out = result.size();
+  EXPECT_EQ(deflate(&z, Z_FINISH), Z_STREAM_END);
+  result.resize(z.total_out);
+  deflateEnd(&z);
+  return result;
+}
+
+// Files written into a temporary directory, removed with it.
+class TempFiles {
+ public:
+  TempFiles() {
+    char dir[] = "/tmp/parallel_test.XXXXXX";
+    EXPECT_NE(mkdtemp(dir), nullptr);
+    dir_ = dir;
+  }
+  ~TempFiles() {
+    for (const std::string& path : paths_) unlink(path.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  std::string Add(const std::string& name, const std::string& data) {
+    std::string path = absl::StrCat(dir_, "/", name);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(write(fd, data.data(), data.size()), data.size());
+    close(fd);
+    paths_.push_back(path);
+    return path;
+  }
+
+  const std::vector<std::string>& paths() const { return paths_; }
+
+ private:
+  std::string dir_;
+  std::vector<std::string> paths_;
+};
+
+// `n` lines of a small number and a name, with repeats.
+std::string MakeLines(int n, int seed) {
+  std::mt19937_64 e(seed);
+  std::string lines;
+  for (int i = 0; i < n; ++i) {
+    absl::StrAppend(&lines, e() % 7, "\tname", e() % 1000, "\n");
+  }
+  return lines;
+}
+
+// Collects tab-separated lines, possibly from several threads.
+class CollectingTable : public OutputTable {
+ public:
+  CollectingTable(int num_columns, std::vector<std::string>* lines)
+      : OutputTable(num_columns), lines_(lines) {}
+  void EndLine() override {
+    std::string line(Text(0));
+    for (int i = 1; i < num_columns(); ++i) {
+      absl::StrAppend(&line, "\t", Text(i));
+    }
+    std::lock_guard lock(mu_);
+    lines_->push_back(std::move(line));
+  }
+  void Finish() override {}
+
+ private:
+  std::vector<std::string>* lines_;
+  std::mutex mu_;
+};
+
+// Lines printed by counting the rows of `files` by `keys` with
+// `num_threads`, sorted.
+std::vector<std::string> Count(const std::vector<std::string>& files,
+                               const std::vector<Table::Key>& keys,
+                               int num_threads) {
+  std::vector<std::string> lines;
+  auto output = std::make_unique<CollectingTable>(keys.size() + 1, &lines);
+  CountAggregator aggregator(keys.size());
+  std::unique_ptr<Table> table;
+  if (keys.size() == 1) {
+    table = std::make_unique<DenseKeyTable<CountAggregator>>(
+        keys[0], aggregator, std::move(output));
+  } else {
+    table = MakeCompositeKeyTable(keys, aggregator, std::move(output), 0);
+  }
+  PushFilesInParallel(num_threads, files, InputRow::kAllFields, *table);
+  table->Finish();
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+TEST(PushFilesInParallel, SameAsSingleThreaded) {
+  TempFiles files;
+  // Several blocks, to be shared by the threads left without a file.
+  files.Add("large", MakeLines(400000, 1));
+  files.Add("small", "1\tname1\n2\tname2");
+  // Two members, as `cat a.gz b.gz` makes.
+  files.Add("c.gz", Gzip(MakeLines(30000, 2)) + Gzip(MakeLines(20000, 3)));
+  files.Add("empty", "");
+  files.Add("other", MakeLines(50000, 4));
+
+  for (const std::vector<Table::Key>& keys :
+       {std::vector<Table::Key>{Table::Key(InputRow::kFileField, 0)},
+        std::vector<Table::Key>{Table::Key(InputRow::kFileField, 0),
+                                Table::Key(1, 1)},
+        std::vector<Table::Key>{Table::Key(2, 0),
+                                Table::Key(InputRow::kFileField, 1)}}) {
+    std::vector<std::string> expected = Count(files.paths(), keys, 1);
+    ASSERT_FALSE(expected.empty());
+    for (int num_threads : {2, 3, 8}) {
+      EXPECT_EQ(Count(files.paths(), keys, num_threads), expected)
+          << "threads: " << num_threads << ", keys: " << keys.size();
+    }
+  }
+  EXPECT_EQ(Count(files.paths(), {Table::Key(InputRow::kFileField, 0)}, 8),
+            (std::vector<std::string>{
+                absl::StrCat(files.paths()[2], "\t50000"),
+                absl::StrCat(files.paths()[0], "\t400000"),
+                absl::StrCat(files.paths()[4], "\t50000"),
+                absl::StrCat(files.paths()[1], "\t2"),
+            }));
+}
+
+// Rows seen by every thread's table, by file. The first batch of each table
+// waits for all of them to have one, so that every thread holds a block of
+// its own at once.
+struct RowsByThread {
+  explicit RowsByThread(int num_tables) : rows(num_tables) {}
+
+  std::mutex mu;
+  std::condition_variable cv;
+  int started = 0;
+  bool timed_out = false;
+  std::vector<std::map<std::string, int>> rows;
+};
+
+class RecordingTable : public Table {
+ public:
+  RecordingTable(std::shared_ptr<RowsByThread> shared, int index)
+      : shared_(std::move(shared)), index_(index) {}
+
+  void PushRow(const InputRow& row) override { LogicError("unbatched row"); }
+  void PushBatch(Batch rows) override {
+    std::unique_lock lock(shared_->mu);
+    if (!started_) {
+      started_ = true;
+      ++shared_->started;
+      shared_->cv.notify_all();
+      int num_tables = shared_->rows.size();
+      if (!shared_->cv.wait_for(lock, std::chrono::seconds(10), [&] {
+            return shared_->started == num_tables;
+          })) {
+        shared_->timed_out = true;
+      }
+    }
+    for (const InputRow* row : rows) {
+      ++shared_->rows[index_][std::string((*row)[InputRow::kFileField])];
+    }
+  }
+  void Finish() override {}
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<RecordingTable>(shared_, ++last_fork_);
+  }
+  void Merge(Table& fork) override {}
+
+ private:
+  std::shared_ptr<RowsByThread> shared_;
+  int index_;
+  bool started_ = false;
+  mutable int last_fork_ = 0;
+};
+
+TEST(PushFilesInParallel, SharesLargestMappedFile) {
+  TempFiles files;
+  std::string large = files.Add("large", MakeLines(400000, 1));
+  std::string compressed = files.Add("c.gz", Gzip(MakeLines(5000, 2)));
+  // One thread per file, and one which has to cut blocks off the large one
+  // while the other two are still on theirs.
+  auto shared = std::make_shared<RowsByThread>(3);
+  RecordingTable table(shared, 0);
+  PushFilesInParallel(3, files.paths(), InputRow::kAllFields, table);
+  EXPECT_FALSE(shared->timed_out);
+
+  int large_readers = 0;
+  int compressed_readers = 0;
+  int large_rows = 0;
+  for (std::map<std::string, int>& rows : shared->rows) {
+    large_readers += rows.contains(large);
+    compressed_readers += rows.contains(compressed);
+    large_rows += rows[large];
+    // The compressed file is read through by a single thread.
+    if (rows.contains(compressed)) {
+      EXPECT_EQ(rows[compressed], 5000);
+    }
+  }
+  EXPECT_GE(large_readers, 2);
+  EXPECT_EQ(compressed_readers, 1);
+  EXPECT_EQ(large_rows, 400000);
+}
+
+}  // namespace
@@ -0,0 +1,115 @@
+#include "partitioned.h"
+
+#include <string>
+#include <thread>
+
+#include "block-queue.h"
+#include "composite-key.h"
+#include "hashed-key.h"
+#include "row-batch.h"
+
+namespace {
+
+constexpr size_t kBatchSize = 1 << 18;
+constexpr size_t kBatchesInFlight = 4;
+
+class PartitionedTable : public BaseCompositeKeyTable {
+ public:
+  PartitionedTable(std::vector<Table::Key> keys,
+                   std::vector<std::unique_ptr<Table>> partitions,
+                   std::unique_ptr<OutputTable> shared_output, int max_field)
+      : BaseCompositeKeyTable(std::move(keys)),
+        shared_output_(std::move(shared_output)) {
+    for (auto& table : partitions) {
+      partitions_.push_back(
+          std::make_unique<Partition>(std::move(table), max_field));
+    }
+  }
+
+  ~PartitionedTable() {
+    for (auto& p : partitions_) p->queue.Close();
+    for (auto& p : partitions_) {
+      if (p->worker.joinable()) p->worker.join();
+    }
+  }
+
+  void PushRow(const InputRow& row) override {
+    // The key is hashed the way partitions would, and they take the hash
+    // along with the line.
+    size_t hash;
+    if (key_.size() == 1) {
+      hash = HashedKey::Hash(row[key_[0].field]);
+    } else {
+      SerializeKey(row);
+      hash = HashedKey::Hash(buf_);
+    }
+    // Partition by the high bits of the hash, hash tables mostly use the low
+    // ones.
+    Partition& p = *partitions_[(hash >> 32) * partitions_.size() >> 32];
+    p.batch.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    p.batch.append(row[0]);
+    p.batch.push_back('\n');
+    if (p.batch.size() >= kBatchSize) {
+      p.queue.Push(std::move(p.batch));
+      p.batch = p.queue.Acquire();
+      p.batch.clear();
+    }
+  }
+
+  void Finish() override {
+    for (auto& p : partitions_) {
+      p->queue.Push(std::move(p->batch));
+      p->queue.Close();
+    }
+    for (auto& p : partitions_) p->worker.join();
+
+    if (shared_output_) {
+      for (auto& p : partitions_) p->table->Finish();
+      shared_output_->Finish();
+    } else {
+      std::vector<std::thread> finishers;
+      for (auto& p : partitions_) {
+        finishers.emplace_back([&p] { p->table->Finish(); });
+      }
+      for (auto& t : finishers) t.join();
+    }
+  }
+
+ private:
+  struct Partition {
+    Partition(std::unique_ptr<Table> t, int max_field)
+        : table(std::move(t)), queue(kBatchesInFlight) {
+      batch = queue.Acquire();
+      worker = std::thread([this, max_field] { Aggregate(max_field); });
+    }
+
+    void Aggregate(int max_field) {
+      RowBatcher batcher(max_field);
+      std::string block;
+      while (queue.Pop(&block)) {
+        batcher.PushHashedLines(block.data(), block.data() + block.size(),
+                                *table);
+        block.clear();
+        queue.Release(std::move(block));
+      }
+    }
+
+    std::unique_ptr<Table> table;
+    BlockQueue queue;
+    std::string batch;
+    std::thread worker;
+  };
+
+  std::unique_ptr<OutputTable> shared_output_;
+  std::vector<std::unique_ptr<Partition>> partitions_;
+};
+
+}  // namespace
+
+std::unique_ptr<Table> MakePartitionedTable(
+    std::vector<Table::Key> keys, std::vector<std::unique_ptr<Table>> partitions,
+    std::unique_ptr<OutputTable> shared_output, int max_field) {
+  return std::make_unique<PartitionedTable>(std::move(keys),
+                                            std::move(partitions),
+                                            std::move(shared_output), max_field);
+}
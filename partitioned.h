@@ -0,0 +1,30 @@
+#ifndef GITHUB_ZISZIS_ZG_PARTITIONED_INCLUDED
+#define GITHUB_ZISZIS_ZG_PARTITIONED_INCLUDED
+
+#include <memory>
+#include <vector>
+
+#include "output.h"
+#include "table.h"
+
+// Aggregation engine for keys with very high cardinality. Rows are sent to
+// one of `partitions` by the hash of their key, and every partition is
+// aggregated and then finished by its own thread, so each group is kept in
+// memory only once.
+//
+// Rows are passed to partitions as text lines, so the table only works at
+// the first pipeline stage (where row[0] is the original input line). The
+// hash a line is routed by goes along, and is what partitions look its key
+// up by (see InputRow::SetKeyHash()), so keys are only hashed once. Routing
+// runs on the thread pushing rows, which can't be forked.
+//
+// Partitions normally produce output on their own. If `shared_output` is
+// given, partitions are expected to forward their lines to it
+// (MakeForwardingTable()); they're finished one at a time then.
+//
+// `max_field` is the highest field index partitions access (see InputRow).
+std::unique_ptr<Table> MakePartitionedTable(
+    std::vector<Table::Key> keys, std::vector<std::unique_ptr<Table>> partitions,
+    std::unique_ptr<OutputTable> shared_output, int max_field);
+
+#endif  // GITHUB_ZISZIS_ZG_PARTITIONED_INCLUDED
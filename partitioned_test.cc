@@ -0,0 +1,128 @@
+#include "partitioned.h"
+
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "aggregators.h"
+#include "composite-key.h"
+#include "dense-key.h"
+#include "gtest/gtest.h"
+#include "output.h"
+#include "row-batch.h"
+
+namespace {
+
+// Collects tab-separated lines, possibly from several threads.
+class CollectingTable : public OutputTable {
+ public:
+  CollectingTable(int num_columns, std::vector<std::string>* lines,
+                  std::mutex* mu)
+      : OutputTable(num_columns), lines_(lines), mu_(mu) {}
+  void EndLine() override {
+    std::string line(Text(0));
+    for (int i = 1; i < num_columns(); ++i) {
+      absl::StrAppend(&line, "\t", Text(i));
+    }
+    std::lock_guard lock(*mu_);
+    lines_->push_back(std::move(line));
+  }
+  void Finish() override {}
+
+ private:
+  std::vector<std::string>* lines_;
+  std::mutex* mu_;
+};
+
+// Counts rows by `keys`, spilling past `max_memory`.
+std::unique_ptr<Table> CountByKeys(const std::vector<Table::Key>& keys,
+                                   std::unique_ptr<OutputTable> output,
+                                   size_t max_memory) {
+  CountAggregator aggregator(keys.size());
+  if (keys.size() == 1) {
+    return std::make_unique<DenseKeyTable<CountAggregator>>(
+        keys[0], aggregator, std::move(output), max_memory);
+  }
+  return std::make_unique<CompositeKeyTable<CountAggregator>>(
+      keys, aggregator, std::move(output), max_memory);
+}
+
+// Lines printed by counting `input` by `keys` in `num_partitions` (or
+// without partitions if 0), sorted. With `downstream`, the counts go to
+// another stage counting them by their first column.
+std::vector<std::string> Count(const std::string& input,
+                               const std::vector<Table::Key>& keys,
+                               int num_partitions, bool downstream) {
+  std::vector<std::string> lines;
+  std::mutex mu;
+  int num_columns = keys.size() + 1;
+  auto make_output = [&]() -> std::unique_ptr<OutputTable> {
+    if (!downstream) {
+      return std::make_unique<CollectingTable>(num_columns, &lines, &mu);
+    }
+    return MakePipeTable(
+        num_columns,
+        CountByKeys({Table::Key(1, 0)},
+                    std::make_unique<CollectingTable>(2, &lines, &mu), 0),
+        InputRow::kAllFields);
+  };
+
+  std::unique_ptr<Table> table;
+  if (num_partitions == 0) {
+    table = CountByKeys(keys, make_output(), 0);
+  } else {
+    std::unique_ptr<OutputTable> shared_output =
+        downstream ? make_output() : nullptr;
+    std::vector<std::unique_ptr<Table>> partitions;
+    for (int i = 0; i < num_partitions; ++i) {
+      partitions.push_back(CountByKeys(
+          keys,
+          shared_output
+              ? MakeForwardingTable(num_columns, shared_output.get())
+              : make_output(),
+          /*max_memory=*/64 << 10));
+    }
+    table = MakePartitionedTable(keys, std::move(partitions),
+                                 std::move(shared_output),
+                                 InputRow::kAllFields);
+  }
+  RowBatcher batcher(InputRow::kAllFields);
+  batcher.PushLines(input.data(), input.data() + input.size(), *table);
+  table->Finish();
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+// Lines of a small number, a name and another number, all with repeats.
+std::string MakeInput() {
+  std::mt19937_64 e(42);
+  std::string input;
+  for (int i = 0; i < 200000; ++i) {
+    absl::StrAppend(&input, e() % 10, "\tname", e() % 20000, "\t", e() % 50,
+                    "\n");
+  }
+  return input;
+}
+
+TEST(PartitionedTable, SameAsUnpartitioned) {
+  std::string input = MakeInput();
+  for (const std::vector<Table::Key>& keys :
+       {std::vector<Table::Key>{Table::Key(2, 0)},
+        std::vector<Table::Key>{Table::Key(1, 0)},
+        std::vector<Table::Key>{Table::Key(2, 0), Table::Key(3, 1)}}) {
+    for (bool downstream : {false, true}) {
+      std::vector<std::string> expected = Count(input, keys, 0, downstream);
+      ASSERT_FALSE(expected.empty());
+      for (int num_partitions : {1, 3, 8}) {
+        EXPECT_EQ(Count(input, keys, num_partitions, downstream), expected)
+            << keys.size() << " keys, " << num_partitions << " partitions"
+            << (downstream ? ", downstream" : "");
+      }
+    }
+  }
+}
+
+}  // namespace
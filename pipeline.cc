@@ -2,13 +2,21 @@
 
 #include "aggregators.h"
 #include "composite-key.h"
+#include "dense-key.h"
 #include "expr.h"
 #include "filter-table.h"
+#include "heavy-hitters.h"
+#include "hyperloglog.h"
 #include "multi-aggregation.h"
 #include "no-keys.h"
+#include "ordered-output.h"
 #include "output.h"
+#include "partitioned.h"
+#include "radix-key.h"
 #include "simple-table.h"
-#include "single-key.h"
+#include "small-key.h"
+#include "sorted-key.h"
+#include "stage-thread.h"
 
 using namespace spec;
 
@@ -22,35 +30,53 @@ int NumColumns(const AggregatedTable::Component& cmp) {
     int operator()(const Max& m) { return std::max<int>(1, m.output.size()); }
     int operator()(const Count&) { return 1; }
     int operator()(const CountDistinct&) { return 1; }
+    int operator()(const ApproxCountDistinct&) { return 1; }
+    int operator()(const Quantile& q) { return q.quantiles.size(); }
+    int operator()(const Histogram&) { return 1; }
   } v;
   return std::visit(v, cmp);
 }
 
 std::unique_ptr<Table> BuildNoAggregationTable(
-    std::vector<Table::Key> keys, std::unique_ptr<OutputTable> output) {
+    std::vector<Table::Key> keys, std::unique_ptr<OutputTable> output,
+    const AggregationOptions& options) {
   if (keys.empty()) LogicError("aggregated table with no columns");
-  if (keys.size() == 1) {
-    return std::make_unique<SingleKeyNoAggregationTable>(keys[0],
-                                                         std::move(output));
+  if (options.sorted) {
+    return std::make_unique<SortedKeyTable<NoAggregator>>(
+        std::move(keys), NoAggregator(), std::move(output));
+  } else if (options.sort_by_hash) {
+    return std::make_unique<RadixKeyTable<NoAggregator>>(
+        std::move(keys), NoAggregator(), std::move(output), options.threads);
+  } else if (keys.size() == 1) {
+    return std::make_unique<SmallKeyTable<NoAggregator>>(
+        keys[0], NoAggregator(), std::move(output), options.max_memory);
   } else {
-    return std::make_unique<CompositeKeyNoAggregationTable>(std::move(keys),
-                                                            std::move(output));
+    return MakeCompositeKeyTable(std::move(keys), NoAggregator(),
+                                 std::move(output), options.max_memory);
   }
 }
 
 template <class Aggregator>
 std::unique_ptr<Table> BuildSingleAggregatorTable(
     std::vector<Table::Key> keys, Aggregator aggregator,
-    std::unique_ptr<OutputTable> output) {
+    std::unique_ptr<OutputTable> output, const AggregationOptions& options) {
   if (keys.empty()) {
     return std::make_unique<NoKeyTable<Aggregator>>(std::move(aggregator),
                                                     std::move(output));
+  } else if (options.sorted) {
+    return std::make_unique<SortedKeyTable<Aggregator>>(
+        std::move(keys), std::move(aggregator), std::move(output));
+  } else if (options.sort_by_hash) {
+    return std::make_unique<RadixKeyTable<Aggregator>>(
+        std::move(keys), std::move(aggregator), std::move(output),
+        options.threads);
   } else if (keys.size() == 1) {
-    return std::make_unique<SingleKeyTable<Aggregator>>(
-        keys[0], std::move(aggregator), std::move(output));
+    return std::make_unique<DenseKeyTable<Aggregator>>(
+        keys[0], std::move(aggregator), std::move(output),
+        options.max_memory);
   } else {
-    return std::make_unique<CompositeKeyTable<Aggregator>>(
-        std::move(keys), std::move(aggregator), std::move(output));
+    return MakeCompositeKeyTable(std::move(keys), std::move(aggregator),
+                                 std::move(output), options.max_memory);
   }
 }
 
@@ -93,34 +119,59 @@ auto AggregatorFromSpec(int column, const Count&, Fn fn) {
 }
 
 template <class Fn>
-auto AggregatorFromSpec(int column, const CountDistinct&, Fn fn) {
-  Unimplemented("count(distinct)");
-  return fn(CountAggregator(column));
+auto AggregatorFromSpec(int column, const CountDistinct& cd, Fn fn) {
+  return fn(CountDistinctAggregator(
+      column, ::Expr<std::string_view>::FromSpec(cd.what)));
 }
 
-std::unique_ptr<Table> AggregateFromSpec(
-    const std::vector<AggregatedTable::Component>& components,
-    std::unique_ptr<Table> pipe_to) {
-  if (components.empty()) LogicError("aggregated table with no columns");
+template <class Fn>
+auto AggregatorFromSpec(int column, const ApproxCountDistinct& acd, Fn fn) {
+  return fn(ApproxCountDistinctAggregator(
+      column, ::Expr<std::string_view>::FromSpec(acd.what), acd.precision));
+}
+
+template <class Fn>
+auto AggregatorFromSpec(int column, const Quantile& q, Fn fn) {
+  return fn(QuantileAggregator(column, ::Expr<Numeric>::FromSpec(q.what),
+                               q.quantiles));
+}
 
+template <class Fn>
+auto AggregatorFromSpec(int column, const Histogram& h, Fn fn) {
+  return fn(HistogramAggregator(column, ::Expr<Numeric>::FromSpec(h.what),
+                                h.precision, h.cumulative));
+}
+
+std::vector<Table::Key> KeysFromSpec(
+    const std::vector<AggregatedTable::Component>& components) {
   std::vector<Table::Key> keys;
   int num_columns = 0;
-  int num_aggs = 0;
   for (const auto& cmp : components) {
     if (const spec::Key* key = std::get_if<spec::Key>(&cmp)) {
       keys.push_back(Table::Key(key->expr.field, num_columns));
-    } else {
-      ++num_aggs;
     }
     num_columns += NumColumns(cmp);
   }
+  return keys;
+}
 
-  std::unique_ptr<OutputTable> output =
-      pipe_to ? MakePipeTable(num_columns, std::move(pipe_to))
-              : MakeStdoutTable(num_columns);
+int NumColumns(const std::vector<AggregatedTable::Component>& components) {
+  int num_columns = 0;
+  for (const auto& cmp : components) num_columns += NumColumns(cmp);
+  return num_columns;
+}
+
+std::unique_ptr<Table> AggregateFromSpec(
+    const std::vector<AggregatedTable::Component>& components,
+    std::unique_ptr<OutputTable> output, const AggregationOptions& options) {
+  if (components.empty()) LogicError("aggregated table with no columns");
+
+  std::vector<Table::Key> keys = KeysFromSpec(components);
+  int num_aggs = components.size() - keys.size();
 
   if (num_aggs == 0) {
-    return BuildNoAggregationTable(std::move(keys), std::move(output));
+    return BuildNoAggregationTable(std::move(keys), std::move(output),
+                                   options);
   } else if (num_aggs == 1) {
     int agg_column = 0;
     for (const auto& cmp : components) {
@@ -128,8 +179,9 @@ std::unique_ptr<Table> AggregateFromSpec(
         return std::visit(
             [&](auto&& agg_spec) {
               return AggregatorFromSpec(agg_column, agg_spec, [&](auto&& agg) {
-                return BuildSingleAggregatorTable(
-                    std::move(keys), std::move(agg), std::move(output));
+                return BuildSingleAggregatorTable(std::move(keys),
+                                                  std::move(agg),
+                                                  std::move(output), options);
               });
             },
             cmp);
@@ -154,26 +206,196 @@ std::unique_ptr<Table> AggregateFromSpec(
       agg_column += NumColumns(cmp);
     }
     return MakeMultiAggregatorTable(std::move(keys), std::move(aggregators),
-                                    std::move(output));
+                                    std::move(output), options);
+  }
+}
+
+static_assert(spec::Expr::kFile == InputRow::kFileField);
+
+// Highest field index referenced by a stage, the input rows don't need to
+// be split any further. At the first stage _0 is the input line itself, at
+// the following ones it's built from all fields. Only the first stage reads
+// input files, so only it has _file; `uses_file` tells if it's referenced.
+int MaxField(const Stage& stage, bool first_stage,
+             bool* uses_file = nullptr) {
+  struct {
+    void operator()(const Key& k) { Add(k.expr); }
+    void operator()(const Sum& s) { Add(s.expr); }
+    void operator()(const Min& m) { Add(m.what, m.output); }
+    void operator()(const Max& m) { Add(m.what, m.output); }
+    void operator()(const Count&) {}
+    void operator()(const CountDistinct& cd) { Add(cd.what); }
+    void operator()(const ApproxCountDistinct& acd) { Add(acd.what); }
+    void operator()(const Quantile& q) { Add(q.what); }
+    void operator()(const Histogram& h) { Add(h.what); }
+    void operator()(const AggregatedTable& t) {
+      for (const auto& cmp : t.components) std::visit(*this, cmp);
+      for (const auto& f : t.filters) Add(f.regexp.what);
+    }
+    void operator()(const SimpleTable& t) {
+      // Implicit output passes through the whole line.
+      if (t.columns.empty()) Add(spec::Expr{.field = 0});
+      for (const auto& e : t.columns) Add(e);
+      for (const auto& f : t.filters) Add(f.regexp.what);
+    }
+
+    void Add(const spec::Expr& e, const std::vector<spec::Expr>& more = {}) {
+      if (e.field == spec::Expr::kFile) {
+        if (!first_stage) Fail("_file only exists at the first stage");
+        uses_file = true;
+      } else if (e.field == 0 && !first_stage) {
+        result = InputRow::kAllFields;
+      } else {
+        result = std::max(result, e.field);
+      }
+      for (const auto& m : more) Add(m);
+    }
+
+    bool first_stage;
+    int result = 0;
+    bool uses_file = false;
+  } v{.first_stage = first_stage};
+  std::visit(v, stage);
+  if (uses_file) *uses_file = v.uses_file;
+  return v.result;
+}
+
+// Where a stage sends its rows: the next stage, or stdout if `table` is null.
+struct Downstream {
+  std::unique_ptr<Table> table;
+  int max_field = InputRow::kAllFields;  // See MaxField().
+  // `table` runs on its own thread (see stage-thread.h).
+  bool own_thread = false;
+};
+
+std::unique_ptr<OutputTable> MakeOutput(int num_columns, Downstream next) {
+  if (next.table && next.own_thread) {
+    return MakeThreadedPipeTable(num_columns, std::move(next.table),
+                                 next.max_field);
+  } else if (next.table) {
+    return MakePipeTable(num_columns, std::move(next.table), next.max_field);
+  } else {
+    return MakeStdoutTable(num_columns);
+  }
+}
+
+// Output of an aggregated stage, ordered if the stage asks for it.
+std::unique_ptr<OutputTable> MakeOutput(const spec::AggregatedTable& spec,
+                                        int num_columns, Downstream next) {
+  std::unique_ptr<OutputTable> output =
+      MakeOutput(num_columns, std::move(next));
+  if (!spec.order) return output;
+  int column = spec.order->by.field - 1;
+  if (column >= num_columns) {
+    Fail("No column ", spec.order->by.field, " to sort by");
+  }
+  return MakeOrderedOutputTable(num_columns, column, spec.order->descending,
+                                spec.limit, std::move(output));
+}
+
+// See partitioned.h. Partitions are fed with input lines, so this only works
+// for the first stage. Filters are applied by partitions, so they run in
+// parallel too. Partitions print on their own unless their lines go to
+// another stage, or have to be ordered.
+std::unique_ptr<Table> PartitionedTableFromSpec(
+    const spec::AggregatedTable& spec, Downstream next, int num_partitions,
+    const AggregationOptions& options) {
+  int num_columns = NumColumns(spec.components);
+  std::unique_ptr<OutputTable> shared_output =
+      next.table || spec.order ? MakeOutput(spec, num_columns, std::move(next))
+                               : nullptr;
+  std::vector<std::unique_ptr<Table>> partitions;
+  for (int i = 0; i < num_partitions; ++i) {
+    std::unique_ptr<OutputTable> output =
+        shared_output ? MakeForwardingTable(num_columns, shared_output.get())
+                      : MakeStdoutTable(num_columns);
+    partitions.push_back(WrapFilter(
+        spec.filters,
+        AggregateFromSpec(spec.components, std::move(output), options)));
   }
+  return MakePartitionedTable(KeysFromSpec(spec.components),
+                              std::move(partitions), std::move(shared_output),
+                              MaxField(spec, /*first_stage=*/true));
+}
+
+// Keys and a count (see heavy-hitters.h). The error column follows the
+// count, and shifts whatever comes after.
+std::unique_ptr<Table> HeavyHittersFromSpec(
+    const spec::AggregatedTable& spec, std::unique_ptr<OutputTable> output) {
+  std::vector<Table::Key> keys;
+  int count_column = 0;
+  int num_columns = 0;
+  for (const auto& cmp : spec.components) {
+    if (const spec::Key* key = std::get_if<spec::Key>(&cmp)) {
+      keys.push_back(Table::Key(key->expr.field, num_columns++));
+    } else {
+      count_column = num_columns;
+      num_columns += 2;
+    }
+  }
+  return std::make_unique<HeavyHittersTable>(std::move(keys), count_column,
+                                             spec.top, std::move(output));
+}
+
+// Memory budget of one of `n` tables sharing `max_memory` (0 is no limit).
+size_t ShareOf(size_t max_memory, int n) {
+  return max_memory == 0 ? 0 : std::max<size_t>(1, max_memory / n);
 }
 
 std::unique_ptr<Table> TableFromSpec(const spec::AggregatedTable& spec,
-                                     std::unique_ptr<Table> pipe_to) {
+                                     Downstream next, const Options& options,
+                                     bool first_stage) {
+  if (spec.top != 0) {
+    // Counters are few enough for forks in threads, but not worth
+    // partitioning.
+    std::unique_ptr<OutputTable> output =
+        MakeOutput(spec, NumColumns(spec.components) + 1, std::move(next));
+    return WrapFilter(spec.filters,
+                      HeavyHittersFromSpec(spec, std::move(output)));
+  }
+  AggregationOptions aggregation{
+      // Only the input itself is known to be sorted.
+      .sorted = first_stage && options.sorted,
+      .max_memory = options.max_memory,
+      // The sort engine can't spill, so a memory budget takes the hash
+      // tables instead.
+      .sort_by_hash = options.engine == Options::Engine::kSort &&
+                      options.max_memory == 0,
+      .threads = options.threads,
+  };
+  // Partitions are passed lines without their file names.
+  bool uses_file = false;
+  MaxField(spec, first_stage, &uses_file);
+  if (first_stage && !aggregation.sorted && options.partitions > 1 &&
+      !KeysFromSpec(spec.components).empty() && !uses_file) {
+    if (options.threads > 1) {
+      Fail("--threads doesn't apply with --partitions: rows are routed to "
+           "partitions by a single thread");
+    }
+    aggregation.max_memory = ShareOf(options.max_memory, options.partitions);
+    return PartitionedTableFromSpec(spec, std::move(next), options.partitions,
+                                    aggregation);
+  }
+  // Every thread aggregates a fork of the table.
+  if (first_stage) {
+    aggregation.max_memory = ShareOf(options.max_memory, options.threads);
+  }
+  std::unique_ptr<OutputTable> output =
+      MakeOutput(spec, NumColumns(spec.components), std::move(next));
   return WrapFilter(spec.filters,
-                    AggregateFromSpec(spec.components, std::move(pipe_to)));
+                    AggregateFromSpec(spec.components, std::move(output),
+                                      aggregation));
 }
 
 std::unique_ptr<Table> TableFromSpec(const spec::SimpleTable& spec,
-                                     std::unique_ptr<Table> pipe_to) {
+                                     Downstream next, const Options&, bool) {
   if (spec.columns.empty()) {
     // We must be the last table, otherwise Optimize() should have fused us.
-    if (pipe_to) LogicError("implicit output inside the pipeline");
+    if (next.table) LogicError("implicit output inside the pipeline");
     return WrapFilter(spec.filters, MakePassthroughTable());
   }
   std::unique_ptr<OutputTable> output =
-      pipe_to ? MakePipeTable(spec.columns.size(), std::move(pipe_to))
-              : MakeStdoutTable(spec.columns.size());
+      MakeOutput(spec.columns.size(), std::move(next));
   return WrapFilter(spec.filters,
                     MakeSimpleTable(spec.columns, std::move(output)));
 }
@@ -216,13 +438,20 @@ void OptimizeSpec(Pipeline* spec) {
 
 }  // namespace
 
-std::unique_ptr<Table> BuildPipeline(spec::Pipeline spec) {
+std::unique_ptr<Table> BuildPipeline(spec::Pipeline spec,
+                                     const Options& options,
+                                     int* max_input_field) {
   OptimizeSpec(&spec);
-  std::unique_ptr<Table> result;
+  Downstream next;
   for (int i = spec.size(); i-- > 0;) {
     std::visit(
-        [&](auto&& stage) { result = TableFromSpec(stage, std::move(result)); },
+        [&](auto&& stage) {
+          next.table = TableFromSpec(stage, std::move(next), options, i == 0);
+        },
         spec[i]);
+    next.max_field = MaxField(spec[i], i == 0);
+    next.own_thread = options.stage_threads;
   }
-  return result;
+  *max_input_field = next.max_field;
+  return std::move(next.table);
 }
@@ -3,9 +3,14 @@
 
 #include <memory>
 
+#include "options.h"
 #include "spec.h"
 #include "table.h"
 
-std::unique_ptr<Table> BuildPipeline(spec::Pipeline spec);
+// Also returns the highest field index of the input lines referenced by the
+// pipeline in `max_input_field` (see InputRow).
+std::unique_ptr<Table> BuildPipeline(spec::Pipeline spec,
+                                     const Options& options,
+                                     int* max_input_field);
 
 #endif  // GITHUB_ZISZIS_ZG_PIPELINE_INCLUDED
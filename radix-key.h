@@ -0,0 +1,183 @@
+#ifndef GITHUB_ZISZIS_ZG_RADIX_KEY_INCLUDED
+#define GITHUB_ZISZIS_ZG_RADIX_KEY_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "composite-key.h"
+#include "hashed-key.h"
+#include "output.h"
+#include "radix-sort.h"
+#include "table.h"
+
+// Aggregating table which doesn't look groups up while rows are pushed.
+// Every row's serialized key and initial state (Aggregator::Init()) are
+// appended to columnar buffers; Finish() radix-sorts rows by key hash (see
+// radix-sort.h) and merges runs of equal keys into groups. For very many
+// distinct keys this trades the cache and TLB misses of random hash table
+// inserts for sequential passes, at the cost of memory proportional to the
+// number of rows rather than groups.
+//
+// Rows are distributed between partitions by the low bits of the hash as
+// they come (the first radix pass, in effect), so that sorting a partition
+// and then visiting its rows in hash order stays within a cache-sized piece
+// of memory. Partitions are sorted in parallel.
+template <class Aggregator>
+class RadixKeyTable : public BaseCompositeKeyTable {
+ public:
+  // `num_threads` sort the rows in Finish().
+  RadixKeyTable(std::vector<Table::Key> key, Aggregator aggregator,
+                std::unique_ptr<OutputTable> output, int num_threads)
+      : BaseCompositeKeyTable(std::move(key)),
+        aggregator_(aggregator),
+        merger_(std::move(aggregator)),
+        output_(std::move(output)),
+        num_threads_(num_threads),
+        partitions_(kNumPartitions) {}
+
+  void PushRow(const InputRow& row) override {
+    SerializeKey(row);
+    size_t hash = HashedKey::Hash(buf_);
+    PartitionOf(hash).Add(buf_, hash, aggregator_.Init(row));
+  }
+
+  void PushBatch(Batch rows) override {
+    for (const InputRow* row : rows) PushRow(*row);
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<RadixKeyTable>(key_, aggregator_, nullptr,
+                                           num_threads_);
+  }
+
+  void Merge(Table& fork) override {
+    auto& that = static_cast<RadixKeyTable&>(fork);
+    for (int p = 0; p < kNumPartitions; ++p) {
+      Partition& from = that.partitions_[p];
+      Partition& to = partitions_[p];
+      to.keys.reserve(to.keys.size() + from.keys.size());
+      for (size_t i = 0; i < from.rows.size(); ++i) {
+        to.Add(from.Key(i), from.rows[i].hash,
+               aggregator_.Copy(that.aggregator_, from.states[i]));
+      }
+      from = Partition();
+    }
+    that.aggregator_.Reset();
+  }
+
+  void Finish() override {
+    // Partitions are sorted by up to num_threads_ threads at a time, but
+    // groups have to be printed by one.
+    std::atomic<size_t> next = 0;
+    auto sort_partitions = [&] {
+      for (size_t p; (p = next++) < partitions_.size();) {
+        RadixSortByHash(&partitions_[p].rows, 1);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads_; ++i) {
+      threads.emplace_back(sort_partitions);
+    }
+    sort_partitions();
+    for (auto& t : threads) t.join();
+
+    for (Partition& partition : partitions_) {
+      PrintPartition(partition);
+      partition = Partition();
+    }
+    aggregator_.Reset();
+    merger_.Reset();
+    output_->Finish();
+  }
+
+ private:
+  using State = typename Aggregator::State;
+
+  static constexpr int kPartitionBits = 8;
+  static constexpr int kNumPartitions = 1 << kPartitionBits;
+
+  // Rows in the order they were added, until Finish() sorts `rows`.
+  struct Partition {
+    void Add(std::string_view key, size_t hash, State state) {
+      keys.append(key);
+      rows.push_back({hash, key_ends.size()});
+      key_ends.push_back(keys.size());
+      states.push_back(std::move(state));
+    }
+
+    std::string_view Key(size_t i) const {
+      size_t begin = i == 0 ? 0 : key_ends[i - 1];
+      return std::string_view(keys.data() + begin, key_ends[i] - begin);
+    }
+
+    std::string keys;
+    std::vector<size_t> key_ends;
+    std::vector<HashedIndex> rows;
+    std::vector<State> states;
+  };
+
+  Partition& PartitionOf(size_t hash) {
+    return partitions_[hash & (kNumPartitions - 1)];
+  }
+
+  void PrintPartition(Partition& partition) {
+    std::vector<HashedIndex>& rows = partition.rows;
+    auto key_of = [&](size_t i) { return partition.Key(rows[i].index); };
+    for (size_t begin = 0; begin < rows.size();) {
+      size_t end = begin + 1;
+      while (end < rows.size() && rows[end].hash == rows[begin].hash) ++end;
+      // Different keys with the same hash are rare, but have to be made
+      // adjacent.
+      if (!std::all_of(rows.begin() + begin + 1, rows.begin() + end,
+                       [&](const HashedIndex& row) {
+                         return partition.Key(row.index) == key_of(begin);
+                       })) {
+        std::stable_sort(rows.begin() + begin, rows.begin() + end,
+                         [&](const HashedIndex& a, const HashedIndex& b) {
+                           return partition.Key(a.index) <
+                                  partition.Key(b.index);
+                         });
+      }
+      for (size_t group = begin; group < end;) {
+        size_t group_end = group + 1;
+        while (group_end < end && key_of(group_end) == key_of(group)) {
+          ++group_end;
+        }
+        PrintGroup(partition, group, group_end);
+        group = group_end;
+      }
+      begin = end;
+    }
+  }
+
+  // Merges the states of partition.rows[begin, end), which all have the same
+  // key, and prints the group.
+  void PrintGroup(const Partition& partition, size_t begin, size_t end) {
+    const std::vector<HashedIndex>& rows = partition.rows;
+    State state =
+        merger_.Copy(aggregator_, partition.states[rows[begin].index]);
+    for (size_t i = begin + 1; i < end; ++i) {
+      merger_.Merge(aggregator_, partition.states[rows[i].index], state);
+    }
+    RenderKey(partition.Key(rows[begin].index), *output_);
+    merger_.Print(state, *output_);
+    output_->EndLine();
+    // Releases whatever the merger keeps for printed groups now and then.
+    if (++num_printed_ % kBatchSize == 0) merger_.Reset();
+  }
+
+  // Initializes states of all rows.
+  Aggregator aggregator_;
+  // Merges states of rows into groups, which keeps them apart from the rows
+  // in aggregators with storage of their own (see ArgMAggregator).
+  Aggregator merger_;
+  std::unique_ptr<OutputTable> output_;
+  int num_threads_;
+  std::vector<Partition> partitions_;
+  size_t num_printed_ = 0;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_RADIX_KEY_INCLUDED
@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "absl/strings/str_cat.h"
+#include "base.h"
+#include "options.h"
+#include "pipeline.h"
+#include "row-batch.h"
+#include "spec-parser.h"
+
+// End-to-end aggregation of twice as many rows as distinct keys, pushed
+// through the pipeline the way zg does. The second stage swallows all
+// groups, so nothing is printed.
+//
+// Args: engine (0: hash, 1: sort), number of distinct keys.
+static void BM_Aggregate(benchmark::State& state) {
+  Options options;
+  options.engine = state.range(0) ? Options::Engine::kSort
+                                   : Options::Engine::kHash;
+  state.SetLabel(state.range(0) ? "sort" : "hash");
+  size_t num_distinct = state.range(1);
+  size_t num_rows = 2 * num_distinct;
+  constexpr size_t kBlockRows = 1 << 16;
+
+  std::mt19937_64 e(42);
+  std::uniform_int_distribution<size_t> dist(0, num_distinct - 1);
+  std::string block;
+  for (auto _ : state) {
+    int max_field;
+    std::unique_ptr<Table> table = BuildPipeline(
+        spec::Parse("k1 s2 => f2~x"), options, &max_field);
+    RowBatcher batcher(max_field);
+    for (size_t begin = 0; begin < num_rows; begin += kBlockRows) {
+      state.PauseTiming();
+      block.clear();
+      for (size_t i = begin; i < std::min(begin + kBlockRows, num_rows);
+           ++i) {
+        absl::StrAppend(&block, "key", dist(e) * 7919, " ", i % 100, "\n");
+      }
+      state.ResumeTiming();
+      batcher.PushLines(block.data(), block.data() + block.size(), *table);
+    }
+    table->Finish();
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows);
+}
+BENCHMARK(BM_Aggregate)
+    ->ArgsProduct({{0, 1}, {1'000'000, 10'000'000, 100'000'000}})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,115 @@
+#include "radix-sort.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace {
+
+constexpr int kRadixBits = 8;
+constexpr size_t kNumBuckets = 1 << kRadixBits;
+constexpr int kTopShift = 64 - kRadixBits;
+
+// Buckets smaller than this are sorted by comparison instead.
+constexpr size_t kMinRadixSortSize = 64;
+
+// Threads of the first pass get at least this many entries each.
+constexpr size_t kMinSliceSize = 1 << 16;
+
+using Counts = std::array<size_t, kNumBuckets>;
+
+size_t Digit(uint64_t hash, int shift) {
+  return (hash >> shift) & (kNumBuckets - 1);
+}
+
+bool Less(const HashedIndex& a, const HashedIndex& b) {
+  return a.hash < b.hash || (a.hash == b.hash && a.index < b.index);
+}
+
+// Sorts `n` entries whose hashes are equal above bit `shift` + kRadixBits.
+// Distribution passes keep entries with equal digits in order, so entries
+// end up ordered by index as well.
+void SortBucket(HashedIndex* data, HashedIndex* tmp, size_t n, int shift) {
+  if (n < kMinRadixSortSize) {
+    std::sort(data, data + n, Less);
+    return;
+  }
+  if (shift < 0) return;
+  Counts begin = {};
+  for (size_t i = 0; i < n; ++i) ++begin[Digit(data[i].hash, shift)];
+  size_t offset = 0;
+  for (size_t& b : begin) offset += std::exchange(b, offset);
+  Counts pos = begin;
+  for (size_t i = 0; i < n; ++i) {
+    tmp[pos[Digit(data[i].hash, shift)]++] = data[i];
+  }
+  memcpy(data, tmp, n * sizeof(HashedIndex));
+  for (size_t b = 0; b < kNumBuckets; ++b) {
+    size_t end = b + 1 < kNumBuckets ? begin[b + 1] : n;
+    SortBucket(data + begin[b], tmp + begin[b], end - begin[b],
+               shift - kRadixBits);
+  }
+}
+
+// Runs fn(0), ..., fn(num_threads - 1) in parallel, the first one on the
+// calling thread.
+template <class Fn>
+void RunInParallel(int num_threads, Fn fn) {
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) threads.emplace_back(fn, i);
+  fn(0);
+  for (auto& t : threads) t.join();
+}
+
+}  // namespace
+
+void RadixSortByHash(std::vector<HashedIndex>* entries, int num_threads) {
+  size_t n = entries->size();
+  HashedIndex* data = entries->data();
+  if (n < kMinRadixSortSize) return std::sort(data, data + n, Less);
+  std::unique_ptr<HashedIndex[]> tmp(new HashedIndex[n]);
+  num_threads = std::clamp<size_t>(n / kMinSliceSize, 1, num_threads);
+
+  // Every thread counts and then distributes its own slice of the input.
+  // Slices land in their buckets in order, so the pass is stable.
+  auto slice = [&](int t) {
+    return std::pair(n * t / num_threads, n * (t + 1) / num_threads);
+  };
+  std::vector<Counts> pos(num_threads, Counts{});
+  RunInParallel(num_threads, [&](int t) {
+    auto [begin, end] = slice(t);
+    for (size_t i = begin; i < end; ++i) {
+      ++pos[t][Digit(data[i].hash, kTopShift)];
+    }
+  });
+  Counts begin;
+  size_t offset = 0;
+  for (size_t b = 0; b < kNumBuckets; ++b) {
+    begin[b] = offset;
+    for (int t = 0; t < num_threads; ++t) {
+      offset += std::exchange(pos[t][b], offset);
+    }
+  }
+  RunInParallel(num_threads, [&](int t) {
+    auto [begin, end] = slice(t);
+    for (size_t i = begin; i < end; ++i) {
+      tmp[pos[t][Digit(data[i].hash, kTopShift)]++] = data[i];
+    }
+  });
+
+  // Buckets are moved back and sorted by whichever thread is free next.
+  std::atomic<size_t> next_bucket = 0;
+  RunInParallel(num_threads, [&](int) {
+    for (size_t b; (b = next_bucket++) < kNumBuckets;) {
+      size_t size = (b + 1 < kNumBuckets ? begin[b + 1] : n) - begin[b];
+      memcpy(data + begin[b], tmp.get() + begin[b],
+             size * sizeof(HashedIndex));
+      SortBucket(data + begin[b], tmp.get() + begin[b], size,
+                 kTopShift - kRadixBits);
+    }
+  });
+}
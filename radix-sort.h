@@ -0,0 +1,21 @@
+#ifndef GITHUB_ZISZIS_ZG_RADIX_SORT_INCLUDED
+#define GITHUB_ZISZIS_ZG_RADIX_SORT_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A hash together with the index of whatever was hashed.
+struct HashedIndex {
+  uint64_t hash;
+  size_t index;
+};
+
+// Sorts `entries` by hash, and entries with equal hashes by index, using an
+// MSD radix sort. The first pass distributes entries by the top byte of the
+// hash, with `num_threads` threads each taking a slice of the input; the
+// resulting buckets are then sorted by the following bytes, up to
+// `num_threads` at a time. Takes scratch space as big as `entries`.
+void RadixSortByHash(std::vector<HashedIndex>* entries, int num_threads);
+
+#endif  // GITHUB_ZISZIS_ZG_RADIX_SORT_INCLUDED
@@ -0,0 +1,57 @@
+#include "radix-sort.h"
+
+#include <algorithm>
+#include <random>
+
+#include "gtest/gtest.h"
+
+bool Less(const HashedIndex& a, const HashedIndex& b) {
+  return a.hash < b.hash || (a.hash == b.hash && a.index < b.index);
+}
+
+bool operator==(const HashedIndex& a, const HashedIndex& b) {
+  return a.hash == b.hash && a.index == b.index;
+}
+
+// `num_distinct` random hashes, each repeated about n / num_distinct times.
+std::vector<HashedIndex> RandomEntries(size_t n, size_t num_distinct) {
+  std::mt19937_64 e(42);
+  std::vector<uint64_t> hashes(num_distinct);
+  for (uint64_t& h : hashes) h = e();
+  std::uniform_int_distribution<size_t> dist(0, num_distinct - 1);
+  std::vector<HashedIndex> result;
+  for (size_t i = 0; i < n; ++i) result.push_back({hashes[dist(e)], i});
+  return result;
+}
+
+void ExpectSorts(std::vector<HashedIndex> entries, int num_threads) {
+  std::vector<HashedIndex> expected = entries;
+  std::sort(expected.begin(), expected.end(), Less);
+  RadixSortByHash(&entries, num_threads);
+  EXPECT_EQ(entries, expected);
+}
+
+TEST(RadixSortByHash, Small) {
+  ExpectSorts({}, 1);
+  ExpectSorts({{3, 0}, {1, 1}, {3, 2}, {2, 3}}, 1);
+}
+
+TEST(RadixSortByHash, Distinct) {
+  ExpectSorts(RandomEntries(1 << 20, 1 << 20), 1);
+  ExpectSorts(RandomEntries(1 << 20, 1 << 20), 4);
+}
+
+TEST(RadixSortByHash, Repeated) {
+  // Runs of equal hashes stay in index order.
+  ExpectSorts(RandomEntries(1 << 20, 100), 1);
+  ExpectSorts(RandomEntries(1 << 20, 1), 3);
+}
+
+TEST(RadixSortByHash, SharedPrefixes) {
+  // Hashes differing only in the low bits go through every pass.
+  std::vector<HashedIndex> entries;
+  for (size_t i = 0; i < 100000; ++i) {
+    entries.push_back({0xabcdef0000000000 + (i * 7919) % 5000, i});
+  }
+  ExpectSorts(entries, 2);
+}
@@ -0,0 +1,36 @@
+#include "row-batch.h"
+
+#include <cstring>
+
+#include "input.h"
+
+RowBatcher::RowBatcher(int max_field)
+    : rows_(Table::kBatchSize, InputRow(max_field)) {
+  batch_.reserve(Table::kBatchSize);
+}
+
+void RowBatcher::PushLines(const char* begin, const char* end, Table& table) {
+  ForEachLineInBlock(begin, end, [&](const char* begin, const char* end) {
+    InputRow& row = rows_[batch_.size()];
+    row.Reset(std::string_view(begin, end - begin));
+    Push(row, table);
+  });
+  Flush(table);
+}
+
+void RowBatcher::PushHashedLines(const char* begin, const char* end,
+                                 Table& table) {
+  while (begin != end) {
+    size_t hash;
+    memcpy(&hash, begin, sizeof(hash));
+    begin += sizeof(hash);
+    const char* eol =
+        static_cast<const char*>(memchr(begin, '\n', end - begin));
+    InputRow& row = rows_[batch_.size()];
+    row.Reset(std::string_view(begin, eol - begin));
+    row.SetKeyHash(hash);
+    Push(row, table);
+    begin = eol + 1;
+  }
+  Flush(table);
+}
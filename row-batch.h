@@ -0,0 +1,47 @@
+#ifndef GITHUB_ZISZIS_ZG_ROW_BATCH_INCLUDED
+#define GITHUB_ZISZIS_ZG_ROW_BATCH_INCLUDED
+
+#include <string_view>
+#include <vector>
+
+#include "table.h"
+#include "types.h"
+
+// Turns blocks of input lines into row batches for Table::PushBatch().
+class RowBatcher {
+ public:
+  // `max_field` is passed to InputRow.
+  explicit RowBatcher(int max_field);
+
+  // Lines pushed from now on come from `file` (see InputRow::SetFile()).
+  void SetFile(std::string_view file) {
+    for (InputRow& row : rows_) row.SetFile(file);
+  }
+
+  // Pushes all lines from a block (see ForEachLineInBlock()) into `table`.
+  void PushLines(const char* begin, const char* end, Table& table);
+
+  // Same for a block of lines each preceded by the hash of its key (see
+  // InputRow::SetKeyHash()), as 8 bytes in native order.
+  void PushHashedLines(const char* begin, const char* end, Table& table);
+
+ private:
+  void Push(InputRow& row, Table& table) {
+    batch_.push_back(&row);
+    if (batch_.size() == rows_.size()) {
+      table.PushBatch(batch_);
+      batch_.clear();
+    }
+  }
+  void Flush(Table& table) {
+    if (!batch_.empty()) {
+      table.PushBatch(batch_);
+      batch_.clear();
+    }
+  }
+
+  std::vector<InputRow> rows_;
+  std::vector<const InputRow*> batch_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_ROW_BATCH_INCLUDED
@@ -1,69 +1,111 @@
 #ifndef GITHUB_ZISZIS_ZG_SINGLE_KEY_INCLUDED
 #define GITHUB_ZISZIS_ZG_SINGLE_KEY_INCLUDED
 
-#include "absl/container/flat_hash_map.h"
-#include "absl/container/flat_hash_set.h"
+#include <string>
+#include <vector>
+
+#include "hashed-key.h"
+#include "spill.h"
 #include "table.h"
 
 template <class Aggregator>
 class SingleKeyTable : public Table {
  public:
+  using State = typename Aggregator::State;
+
+  // Groups are spilled to disk once they take more than `max_memory` bytes
+  // (see spill.h), 0 means no limit.
   SingleKeyTable(Table::Key key, Aggregator aggregator,
-                 std::unique_ptr<OutputTable> output)
+                 std::unique_ptr<OutputTable> output, size_t max_memory = 0)
       : key_(std::move(key)),
         aggregator_(std::move(aggregator)),
-        output_(std::move(output)) {}
+        output_(std::move(output)),
+        spiller_(max_memory, aggregator_) {}
 
   void PushRow(const InputRow& row) override {
-    auto it = state_.find(row[key_.field]);
-    if (it == state_.end()) {
-      state_.emplace_hint(it, row[key_.field], aggregator_.Init(row));
-    } else {
-      aggregator_.Update(row, it->second);
-    }
+    state_.InsertOrUpdate(
+        HashedKey(row[key_.field], row.key_hash()),
+        [&] { return aggregator_.Init(row); },
+        [&](State& state) { aggregator_.Update(row, state); });
+    spiller_.MaybeSpill(state_, aggregator_);
   }
 
-  void Finish() override {
-    for (const auto& [key, value] : state_) {
-      output_->Set(key_.column, key);
-      aggregator_.Print(value, *output_);
-      output_->EndLine();
+  void PushBatch(Batch rows) override {
+    keys_.clear();
+    for (const InputRow* row : rows) {
+      keys_.emplace_back((*row)[key_.field], row->key_hash());
     }
-    decltype(state_)().swap(state_);
-    aggregator_.Reset();
-    output_->Finish();
+
+    // States of existing keys are collected first and updated afterwards.
+    updated_rows_.clear();
+    updated_states_.clear();
+    state_.InsertOrUpdateBatch(
+        std::span<const HashedKey>(keys_),
+        [&](size_t i) { return aggregator_.Init(*rows[i]); },
+        [&](size_t i, State& state) {
+          updated_rows_.push_back(rows[i]);
+          updated_states_.push_back(&state);
+        });
+    UpdateBatch(aggregator_, Batch(updated_rows_),
+                std::span<State* const>(updated_states_));
+    spiller_.MaybeSpill(state_, aggregator_);
   }
 
- private:
-  absl::flat_hash_map<std::string, typename Aggregator::State> state_;
-  Table::Key key_;
-  Aggregator aggregator_;
-  std::unique_ptr<OutputTable> output_;
-};
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<SingleKeyTable>(key_, aggregator_, nullptr,
+                                            spiller_.max_memory());
+  }
 
-class SingleKeyNoAggregationTable : public Table {
- public:
-  SingleKeyNoAggregationTable(Table::Key key,
-                              std::unique_ptr<OutputTable> output)
-      : key_(std::move(key)), output_(std::move(output)) {}
+  void Merge(Table& fork) override {
+    auto& that = static_cast<SingleKeyTable&>(fork);
+    state_.MergeFrom(
+        that.state_,
+        [&](const State& from) {
+          return aggregator_.Copy(that.aggregator_, from);
+        },
+        [&](const State& from, State& state) {
+          aggregator_.Merge(that.aggregator_, from, state);
+        });
+    that.state_.clear();
+    that.aggregator_.Reset();
+    spiller_.Adopt(that.spiller_);
+    spiller_.MaybeSpill(state_, aggregator_);
+  }
 
-  void PushRow(const InputRow& row) override {
-    state_.emplace(row[key_.field]);
+  // Adds a group aggregated by another instance of the aggregator, the way
+  // Merge() does for all groups of a fork.
+  void MergeGroup(std::string_view key, const Aggregator& from,
+                  const State& value) {
+    state_.InsertOrUpdate(
+        HashedKey(key), [&] { return aggregator_.Copy(from, value); },
+        [&](State& state) { aggregator_.Merge(from, value, state); });
+    spiller_.MaybeSpill(state_, aggregator_);
   }
 
   void Finish() override {
-    for (const auto& key : state_) {
-      output_->Set(key_.column, key);
-      output_->EndLine();
-    }
-    decltype(state_)().swap(state_);
+    spiller_.Finish(state_, aggregator_, [&] {
+      for (const auto& [key, value] : state_) {
+        output_->Set(key_.column, key.value());
+        aggregator_.Print(value, *output_);
+        output_->EndLine();
+      }
+    });
+    state_.clear();
+    aggregator_.Reset();
     output_->Finish();
   }
 
  private:
-  absl::flat_hash_set<std::string> state_;
+  HashedKeyMap<State> state_;
   Table::Key key_;
+  Aggregator aggregator_;
   std::unique_ptr<OutputTable> output_;
+  GroupSpiller<Aggregator> spiller_;
+
+  // PushBatch() scratch space.
+  std::vector<HashedKey> keys_;
+  std::vector<const InputRow*> updated_rows_;
+  std::vector<State*> updated_states_;
 };
 
 #endif  // GITHUB_ZISZIS_ZG_SINGLE_KEY_INCLUDED
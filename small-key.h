@@ -0,0 +1,226 @@
+#ifndef GITHUB_ZISZIS_ZG_SMALL_KEY_INCLUDED
+#define GITHUB_ZISZIS_ZG_SMALL_KEY_INCLUDED
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "output.h"
+#include "single-key.h"
+#include "table.h"
+
+// Single key table for a handful of distinct keys (methods, log levels...),
+// which are found faster by comparing against each of them than by hashing.
+// Keys are compared by length and their first 16 bytes in one go, starting
+// with the key found last. Once there are more than kMaxKeys distinct keys,
+// or the aggregator takes more than `max_memory`, all groups move into a
+// SingleKeyTable, which takes all rows from then on (and spills them).
+template <class Aggregator>
+class SmallKeyTable : public Table {
+ public:
+  using State = typename Aggregator::State;
+
+  // See SingleKeyTable for `max_memory`.
+  SmallKeyTable(Table::Key key, Aggregator aggregator,
+                std::unique_ptr<OutputTable> output, size_t max_memory = 0)
+      : key_(key),
+        aggregator_(aggregator),
+        output_(std::move(output)),
+        hashed_(key, std::move(aggregator),
+                output_ ? MakeForwardingTable(output_->num_columns(),
+                                              output_.get())
+                        : nullptr,
+                max_memory),
+        max_memory_(max_memory) {
+    // Collected states must not move while a batch is pushed.
+    states_.reserve(kMaxKeys);
+  }
+
+  void PushRow(const InputRow& row) override {
+    if (small_) {
+      std::string_view key = row[key_.field];
+      if (int i = Find(key); i >= 0) {
+        aggregator_.Update(row, states_[i]);
+        return CheckMemory();
+      } else if (keys_.size() < kMaxKeys) {
+        Add(key, aggregator_.Init(row));
+        return CheckMemory();
+      }
+      SwitchToHashTable();
+    }
+    hashed_.PushRow(row);
+  }
+
+  void PushBatch(Batch rows) override {
+    if (!small_) return hashed_.PushBatch(rows);
+
+    updated_rows_.clear();
+    updated_states_.clear();
+    size_t i = 0;
+    for (; i < rows.size(); ++i) {
+      std::string_view key = (*rows[i])[key_.field];
+      if (int k = Find(key); k >= 0) {
+        updated_rows_.push_back(rows[i]);
+        updated_states_.push_back(&states_[k]);
+      } else if (keys_.size() < kMaxKeys) {
+        Add(key, aggregator_.Init(*rows[i]));
+      } else {
+        break;
+      }
+    }
+    UpdateBatch(aggregator_, Batch(updated_rows_),
+                std::span<State* const>(updated_states_));
+    if (i < rows.size()) {
+      SwitchToHashTable();
+      hashed_.PushBatch(rows.subspan(i));
+    } else {
+      CheckMemory();
+    }
+  }
+
+  std::unique_ptr<Table> Fork() const override {
+    return std::make_unique<SmallKeyTable>(key_, aggregator_, nullptr,
+                                           max_memory_);
+  }
+
+  void Merge(Table& fork) override {
+    auto& that = static_cast<SmallKeyTable&>(fork);
+    if (!that.small_) SwitchToHashTable();
+    for (size_t i = 0; i < that.keys_.size(); ++i) {
+      MergeGroup(that.keys_[i], that.aggregator_, that.states_[i]);
+    }
+    that.Clear();
+    that.aggregator_.Reset();
+    hashed_.Merge(that.hashed_);
+  }
+
+  // See SingleKeyTable::MergeGroup().
+  void MergeGroup(std::string_view key, const Aggregator& from,
+                  const State& value) {
+    if (small_) {
+      if (int i = Find(key); i >= 0) {
+        aggregator_.Merge(from, value, states_[i]);
+        return CheckMemory();
+      } else if (keys_.size() < kMaxKeys) {
+        Add(key, aggregator_.Copy(from, value));
+        return CheckMemory();
+      }
+      SwitchToHashTable();
+    }
+    hashed_.MergeGroup(key, from, value);
+  }
+
+  void Finish() override {
+    hashed_.Finish();
+    for (size_t i = 0; i < keys_.size(); ++i) {
+      output_->Set(key_.column, keys_[i]);
+      aggregator_.Print(states_[i], *output_);
+      output_->EndLine();
+    }
+    Clear();
+    aggregator_.Reset();
+    output_->Finish();
+  }
+
+ private:
+  static constexpr size_t kMaxKeys = 32;
+
+  // First 16 bytes of a key, zero-padded.
+  struct alignas(16) Prefix {
+    explicit Prefix(std::string_view key) {
+      if (!key.empty()) {
+        memcpy(bytes, key.data(), std::min(key.size(), sizeof(bytes)));
+      }
+    }
+
+    bool operator==(const Prefix& other) const {
+#if defined(__x86_64__)
+      __m128i eq = _mm_cmpeq_epi8(
+          _mm_load_si128(reinterpret_cast<const __m128i*>(bytes)),
+          _mm_load_si128(reinterpret_cast<const __m128i*>(other.bytes)));
+      return _mm_movemask_epi8(eq) == 0xffff;
+#else
+      return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+#endif
+    }
+
+    char bytes[16] = {};
+  };
+
+  bool Matches(size_t i, std::string_view key, const Prefix& prefix) const {
+    return sizes_[i] == key.size() && prefixes_[i] == prefix &&
+           (key.size() <= sizeof(prefix.bytes) ||
+            memcmp(keys_[i].data() + sizeof(prefix.bytes),
+                   key.data() + sizeof(prefix.bytes),
+                   key.size() - sizeof(prefix.bytes)) == 0);
+  }
+
+  // Index of `key` in keys_, or -1.
+  int Find(std::string_view key) {
+    if (keys_.empty()) return -1;
+    Prefix prefix(key);
+    if (Matches(last_, key, prefix)) return last_;
+    for (size_t i = 0; i < keys_.size(); ++i) {
+      if (Matches(i, key, prefix)) return last_ = i;
+    }
+    return -1;
+  }
+
+  void Add(std::string_view key, State state) {
+    prefixes_.emplace_back(key);
+    sizes_.push_back(key.size());
+    keys_.emplace_back(key);
+    states_.push_back(std::move(state));
+    last_ = keys_.size() - 1;
+  }
+
+  void Clear() {
+    prefixes_.clear();
+    sizes_.clear();
+    keys_.clear();
+    states_.clear();
+    last_ = 0;
+  }
+
+  // States are few, but the aggregator may hold any amount of memory for
+  // them, which only the hash table can spill.
+  void CheckMemory() {
+    if (max_memory_ != 0 && aggregator_.MemoryUsage() > max_memory_) {
+      SwitchToHashTable();
+    }
+  }
+
+  void SwitchToHashTable() {
+    if (!small_) return;
+    for (size_t i = 0; i < keys_.size(); ++i) {
+      hashed_.MergeGroup(keys_[i], aggregator_, states_[i]);
+    }
+    Clear();
+    aggregator_.Reset();
+    small_ = false;
+  }
+
+  bool small_ = true;
+  std::vector<Prefix> prefixes_;
+  std::vector<size_t> sizes_;
+  std::vector<std::string> keys_;
+  std::vector<State> states_;
+  int last_ = 0;
+  Table::Key key_;
+  Aggregator aggregator_;
+  std::unique_ptr<OutputTable> output_;
+  // All groups once small_ is false, printed through output_.
+  SingleKeyTable<Aggregator> hashed_;
+  size_t max_memory_;
+
+  // PushBatch() scratch space.
+  std::vector<const InputRow*> updated_rows_;
+  std::vector<State*> updated_states_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_SMALL_KEY_INCLUDED
@@ -0,0 +1,121 @@
+#include "small-key.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "aggregators.h"
+#include "gtest/gtest.h"
+#include "output.h"
+
+namespace {
+
+// Collects counts by key.
+class CollectingTable : public OutputTable {
+ public:
+  explicit CollectingTable(std::map<std::string, int64_t>* counts)
+      : OutputTable(2), counts_(counts) {}
+  void EndLine() override {
+    int64_t count = 0;
+    EXPECT_TRUE(absl::SimpleAtoi(Text(1), &count));
+    EXPECT_TRUE(counts_->emplace(std::string(Text(0)), count).second)
+        << "key printed twice: " << Text(0);
+  }
+  void Finish() override {}
+
+ private:
+  std::map<std::string, int64_t>* counts_;
+};
+
+// Keys are whole lines, so that they can be empty or contain spaces.
+std::unique_ptr<Table> MakeTable(std::map<std::string, int64_t>* counts) {
+  return std::make_unique<SmallKeyTable<CountAggregator>>(
+      Table::Key(0, 0), CountAggregator(1),
+      std::make_unique<CollectingTable>(counts));
+}
+
+// Pushes all keys in one batch, and returns their counts.
+std::map<std::string, int64_t> PushBatch(Table& table,
+                                         const std::vector<std::string>& keys) {
+  std::map<std::string, int64_t> counts;
+  std::vector<InputRow> rows(keys.size());
+  std::vector<const InputRow*> batch;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    rows[i].Reset(keys[i]);
+    batch.push_back(&rows[i]);
+    ++counts[keys[i]];
+  }
+  table.PushBatch(batch);
+  return counts;
+}
+
+TEST(SmallKeyTable, SwitchesInTheMiddleOfABatch) {
+  std::map<std::string, int64_t> printed;
+  std::unique_ptr<Table> table = MakeTable(&printed);
+  // 40 distinct keys in a batch, with repeats on both sides of the switch
+  // to the hash table after 32.
+  std::vector<std::string> keys;
+  for (int i = 0; i < 40; ++i) {
+    keys.push_back(absl::StrCat("key", i));
+    keys.push_back(absl::StrCat("key", i / 2));
+  }
+  std::map<std::string, int64_t> expected = PushBatch(*table, keys);
+  for (const auto& [key, count] : PushBatch(*table, keys)) {
+    expected[key] += count;
+  }
+  table->Finish();
+  EXPECT_EQ(printed, expected);
+}
+
+TEST(SmallKeyTable, ComparesWholeKeys) {
+  std::map<std::string, int64_t> printed;
+  std::unique_ptr<Table> table = MakeTable(&printed);
+  std::string prefix = "0123456789abcdef";
+  // Keys sharing their first 16 bytes, differing in length or past them,
+  // and keys of 0 and exactly 16 bytes.
+  std::vector<std::string> keys = {prefix,
+                                   prefix + "x",
+                                   prefix + "y",
+                                   prefix + "xy",
+                                   prefix + "yx",
+                                   prefix + std::string(20, 'x'),
+                                   prefix + std::string(19, 'x') + "y",
+                                   "",
+                                   "0123456789abcdeg",
+                                   "0123456789abcde",
+                                   prefix + "x",
+                                   "",
+                                   prefix};
+  std::map<std::string, int64_t> expected = PushBatch(*table, keys);
+  for (const std::string& key : keys) {
+    InputRow row;
+    row.Reset(key);
+    table->PushRow(row);
+    ++expected[key];
+  }
+  table->Finish();
+  EXPECT_EQ(printed, expected);
+}
+
+TEST(SmallKeyTable, MergesAcrossModes) {
+  std::map<std::string, int64_t> printed;
+  std::unique_ptr<Table> table = MakeTable(&printed);
+  std::unique_ptr<Table> small = table->Fork();
+  std::unique_ptr<Table> hashed = table->Fork();
+  std::vector<std::string> many;
+  for (int i = 0; i < 50; ++i) many.push_back(absl::StrCat("key", i));
+  std::map<std::string, int64_t> expected = PushBatch(*table, {"a", "b"});
+  for (const auto& part :
+       {PushBatch(*small, {"a", "c", "c"}), PushBatch(*hashed, many)}) {
+    for (const auto& [key, count] : part) expected[key] += count;
+  }
+  table->Merge(*small);
+  table->Merge(*hashed);
+  table->Finish();
+  EXPECT_EQ(printed, expected);
+}
+
+}  // namespace
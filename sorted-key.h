@@ -0,0 +1,84 @@
+#ifndef GITHUB_ZISZIS_ZG_SORTED_KEY_INCLUDED
+#define GITHUB_ZISZIS_ZG_SORTED_KEY_INCLUDED
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "base.h"
+#include "output.h"
+#include "table.h"
+
+// Aggregating table for input sorted by the key, e.g. by `sort`. Only the
+// current group is kept, and it's printed as soon as the key changes, so
+// memory doesn't grow with the number of groups and following stages get
+// rows right away. Keys must be ascending (comparing key fields in order, byte
+// by byte, as `LC_ALL=C sort` does); groups already printed can't be taken
+// back, so any other order is an error.
+template <class Aggregator>
+class SortedKeyTable : public Table {
+ public:
+  SortedKeyTable(std::vector<Table::Key> key, Aggregator aggregator,
+                 std::unique_ptr<OutputTable> output)
+      : key_(std::move(key)),
+        aggregator_(std::move(aggregator)),
+        output_(std::move(output)),
+        current_(key_.size()) {}
+
+  void PushRow(const InputRow& row) override { Push(row); }
+
+  void PushBatch(Batch rows) override {
+    for (const InputRow* row : rows) Push(*row);
+  }
+
+  void Finish() override {
+    if (state_) Flush();
+    output_->Finish();
+  }
+
+ private:
+  using State = typename Aggregator::State;
+
+  void Push(const InputRow& row) {
+    if (state_) {
+      for (size_t i = 0; i < key_.size(); ++i) {
+        std::string_view value = row[key_[i].field];
+        int cmp = value.compare(current_[i]);
+        if (cmp == 0) continue;
+        if (cmp < 0) {
+          Fail("Input is not sorted by the key: ", Quoted(value),
+               " follows ", Quoted(current_[i]));
+        }
+        Flush();
+        break;
+      }
+      if (state_) {
+        aggregator_.Update(row, *state_);
+        return;
+      }
+    }
+    for (size_t i = 0; i < key_.size(); ++i) {
+      current_[i].assign(row[key_[i].field]);
+    }
+    state_ = aggregator_.Init(row);
+  }
+
+  void Flush() {
+    for (size_t i = 0; i < key_.size(); ++i) {
+      output_->Set(key_[i].column, current_[i]);
+    }
+    aggregator_.Print(*state_, *output_);
+    output_->EndLine();
+    state_.reset();
+    // Releases whatever the aggregator keeps for the group's state.
+    aggregator_.Reset();
+  }
+
+  std::vector<Table::Key> key_;
+  Aggregator aggregator_;
+  std::unique_ptr<OutputTable> output_;
+  std::vector<std::string> current_;
+  std::optional<State> state_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_SORTED_KEY_INCLUDED
@@ -0,0 +1,73 @@
+#include "sorted-key.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "aggregators.h"
+#include "gtest/gtest.h"
+#include "output.h"
+
+namespace {
+
+// Collects tab-separated lines, in the order printed.
+class CollectingTable : public OutputTable {
+ public:
+  CollectingTable(int num_columns, std::vector<std::string>* lines)
+      : OutputTable(num_columns), lines_(lines) {}
+  void EndLine() override {
+    std::string line(Text(0));
+    for (int i = 1; i < num_columns(); ++i) {
+      absl::StrAppend(&line, "\t", Text(i));
+    }
+    lines_->push_back(std::move(line));
+  }
+  void Finish() override {}
+
+ private:
+  std::vector<std::string>* lines_;
+};
+
+// Counts lines by their first `num_keys` fields.
+std::vector<std::string> Count(int num_keys,
+                               const std::vector<std::string>& input) {
+  std::vector<Table::Key> keys;
+  for (int i = 0; i < num_keys; ++i) keys.push_back(Table::Key(i + 1, i));
+  std::vector<std::string> lines;
+  SortedKeyTable<CountAggregator> table(
+      keys, CountAggregator(num_keys),
+      std::make_unique<CollectingTable>(num_keys + 1, &lines));
+  std::vector<InputRow> rows(input.size());
+  std::vector<const InputRow*> batch;
+  for (size_t i = 0; i < input.size(); ++i) {
+    rows[i].Reset(input[i]);
+    batch.push_back(&rows[i]);
+  }
+  table.PushBatch(batch);
+  table.Finish();
+  return lines;
+}
+
+TEST(SortedKeyTable, PrintsGroupsInOrder) {
+  EXPECT_EQ(Count(1, {"a", "a", "b", "c", "c", "c"}),
+            (std::vector<std::string>{"a\t2", "b\t1", "c\t3"}));
+  // Bytes compare unsigned, and a prefix goes first, as with LC_ALL=C sort.
+  EXPECT_EQ(Count(1, {"B", "a", "ab", "\xc3\xa9"}),
+            (std::vector<std::string>{"B\t1", "a\t1", "ab\t1", "\xc3\xa9\t1"}));
+}
+
+TEST(SortedKeyTable, ComparesCompositeKeysInOrder) {
+  // A later key field may go down as long as an earlier one goes up.
+  EXPECT_EQ(Count(2, {"a 9", "a 9", "b 1", "b 5", "c 0"}),
+            (std::vector<std::string>{"a\t9\t2", "b\t1\t1", "b\t5\t1",
+                                      "c\t0\t1"}));
+}
+
+TEST(SortedKeyTableDeathTest, FailsOnUnsortedInput) {
+  EXPECT_EXIT(Count(1, {"a", "c", "b"}), testing::ExitedWithCode(1),
+              "Input is not sorted by the key: 'b' follows 'c'");
+  EXPECT_EXIT(Count(2, {"a 2", "b 1", "b 0"}), testing::ExitedWithCode(1),
+              "Input is not sorted by the key: '0' follows '1'");
+}
+
+}  // namespace
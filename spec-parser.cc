@@ -1,5 +1,7 @@
 #include "spec-parser.h"
 
+#include <algorithm>
+#include <limits>
 #include <optional>
 #include <regex>
 
@@ -14,6 +16,7 @@ Tokenizer::Tokenizer(std::string spec) : spec_(std::move(spec)), current_(0) {
       {END, "[ \t\n]+"},  // `END` stands for whitespace in this function
       {PIPE, "=>"},
       {ID, "[_a-zA-Z][_a-zA-Z0-9]*"},
+      {NUMBER, "[0-9]+(?:\\.[0-9]+)?"},
       {OPAREN, "\\("},
       {CPAREN, "\\)"},
       {COMMA, ","},
@@ -92,6 +95,8 @@ Tokenizer::Token Tokenizer::Consume(TokenType type) {
           return "a single-quoted literal";
         case DQUOTED_STRING:
           return "a double-quoted literal";
+        case NUMBER:
+          return "a number";
       }
     }();
     FailParse(absl::StrCat("expected ", expected));
@@ -150,6 +155,9 @@ class Parser : public Tokenizer {
   Stage ParseStage() {
     std::vector<AggregatedTable::Component> agg;
     std::vector<Filter> filters;
+    size_t top = 0;
+    std::optional<Order> order;
+    size_t limit = 0;
 
     while (true) {
       Token token = Peek();
@@ -171,11 +179,21 @@ class Parser : public Tokenizer {
         agg.push_back(ParseMax());
       } else if (token.value == "count") {
         agg.push_back(ParseCount());
+      } else if (token.value == "quantile") {
+        agg.push_back(ParseQuantile());
+      } else if (token.value == "hist") {
+        agg.push_back(ParseHistogram());
       } else if (token.value == "c") {
         ConsumeId("c");
         agg.push_back(Count{});
       } else if (token.value == "filter") {
         filters.push_back(ParseFilter());
+      } else if (token.value == "top") {
+        top = ParseTop();
+      } else if (token.value == "sort") {
+        order = ParseOrder();
+      } else if (token.value == "limit") {
+        limit = ParseLimit();
       } else if (auto expr = TryShortForm("k")) {
         agg.push_back(Key{*expr});
       } else if (auto expr = TryShortForm("s")) {
@@ -188,6 +206,10 @@ class Parser : public Tokenizer {
                           .output = {exprs->begin() + 1, exprs->end()}});
       } else if (auto expr = TryShortForm("cd")) {
         agg.push_back(CountDistinct{*expr});
+      } else if (auto expr = TryShortForm("acd")) {
+        agg.push_back(ApproxCountDistinct{.what = *expr});
+      } else if (auto expr = TryShortForm("h")) {
+        agg.push_back(Histogram{.what = *expr});
       } else if (auto expr = TryShortForm("f")) {
         filters.push_back(ParseShortFilter(*expr));
       } else if (token.value == "f") {
@@ -198,10 +220,29 @@ class Parser : public Tokenizer {
       }
     }
 
+    if (top != 0) {
+      size_t num_keys = std::count_if(agg.begin(), agg.end(), [](auto& c) {
+        return std::holds_alternative<Key>(c);
+      });
+      size_t num_counts = std::count_if(agg.begin(), agg.end(), [](auto& c) {
+        return std::holds_alternative<Count>(c);
+      });
+      if (num_keys == 0 || num_counts != 1 || num_keys + 1 != agg.size()) {
+        FailParse("top() needs keys and a count, and nothing else");
+      }
+    }
+
+    if (limit != 0 && !order) FailParse("limit() needs sort()");
+    if (order && agg.empty()) FailParse("sort() needs an aggregation");
+
     if (agg.empty()) {
       return SimpleTable{.columns = {}, .filters = filters};
     } else {
-      return AggregatedTable{.components = agg, .filters = filters};
+      return AggregatedTable{.components = agg,
+                             .filters = filters,
+                             .top = top,
+                             .order = order,
+                             .limit = limit};
     }
   }
 
@@ -211,8 +252,9 @@ class Parser : public Tokenizer {
       FailParse("expected column reference", 1);
     }
     column.remove_prefix(1);
+    if (column == "file") return Expr{Expr::kFile};
     int index = 0;
-    if (!absl::SimpleAtoi(column, &index)) {
+    if (!absl::SimpleAtoi(column, &index) || index < 0) {
       FailParse("cannot parse column index", 1);
     }
     return Expr{index};
@@ -245,6 +287,7 @@ class Parser : public Tokenizer {
   AggregatedTable::Component ParseCount() {
     ConsumeId("count");
     if (TryConsume(OPAREN)) {
+      if (Peek().value == "approx_distinct") return ParseApproxCountDistinct();
       ConsumeId("distinct");
       Consume(COMMA);
       Expr what = ParseExpr();
@@ -255,6 +298,111 @@ class Parser : public Tokenizer {
     }
   }
 
+  // The rest of count(approx_distinct, _N[, precision]).
+  ApproxCountDistinct ParseApproxCountDistinct() {
+    ConsumeId("approx_distinct");
+    Consume(COMMA);
+    ApproxCountDistinct result{.what = ParseExpr()};
+    if (TryConsume(COMMA)) {
+      Token precision = Consume(NUMBER);
+      if (!absl::SimpleAtoi(precision.value, &result.precision) ||
+          result.precision < ApproxCountDistinct::kMinPrecision ||
+          result.precision > ApproxCountDistinct::kMaxPrecision) {
+        FailParse(absl::StrCat("precision must be between ",
+                               ApproxCountDistinct::kMinPrecision, " and ",
+                               ApproxCountDistinct::kMaxPrecision),
+                  1);
+      }
+    }
+    Consume(CPAREN);
+    return result;
+  }
+
+  Quantile ParseQuantile() {
+    Quantile result;
+    ConsumeId("quantile");
+    Consume(OPAREN);
+    result.what = ParseExpr();
+    do {
+      Consume(COMMA);
+      Token token = Consume(NUMBER);
+      double q;
+      if (!absl::SimpleAtod(token.value, &q) || q < 0 || q > 1) {
+        FailParse("quantile must be between 0 and 1", 1);
+      }
+      result.quantiles.push_back(q);
+    } while (Peek().type == COMMA);
+    Consume(CPAREN);
+    return result;
+  }
+
+  Histogram ParseHistogram() {
+    Histogram result;
+    ConsumeId("hist");
+    Consume(OPAREN);
+    result.what = ParseExpr();
+    if (TryConsume(COMMA)) {
+      if (auto precision = TryConsume(NUMBER)) {
+        if (!absl::SimpleAtoi(precision->value, &result.precision) ||
+            result.precision < Histogram::kMinPrecision ||
+            result.precision > Histogram::kMaxPrecision) {
+          FailParse(absl::StrCat("precision must be between ",
+                                 Histogram::kMinPrecision, " and ",
+                                 Histogram::kMaxPrecision),
+                    1);
+        }
+        if (TryConsume(COMMA)) {
+          ConsumeId("cumulative");
+          result.cumulative = true;
+        }
+      } else {
+        ConsumeId("cumulative");
+        result.cumulative = true;
+      }
+    }
+    Consume(CPAREN);
+    return result;
+  }
+
+  size_t ParseTop() {
+    ConsumeId("top");
+    Consume(OPAREN);
+    Token token = Consume(NUMBER);
+    size_t top;
+    if (!absl::SimpleAtoi(token.value, &top) || top == 0 ||
+        top > std::numeric_limits<uint32_t>::max()) {
+      FailParse("expected number of counters", 1);
+    }
+    Consume(CPAREN);
+    return top;
+  }
+
+  // sort(_N[, desc]), where _N is an output column.
+  Order ParseOrder() {
+    ConsumeId("sort");
+    Consume(OPAREN);
+    Order result{.by = ParseExpr()};
+    if (result.by.field <= 0) FailParse("expected output column", 1);
+    if (TryConsume(COMMA)) {
+      ConsumeId("desc");
+      result.descending = true;
+    }
+    Consume(CPAREN);
+    return result;
+  }
+
+  size_t ParseLimit() {
+    ConsumeId("limit");
+    Consume(OPAREN);
+    Token token = Consume(NUMBER);
+    size_t limit;
+    if (!absl::SimpleAtoi(token.value, &limit) || limit == 0) {
+      FailParse("expected number of lines", 1);
+    }
+    Consume(CPAREN);
+    return limit;
+  }
+
   Filter ParseFilter() {
     ConsumeId("filter");
     Consume(OPAREN);
@@ -291,6 +439,10 @@ class Parser : public Tokenizer {
 
     std::vector<Expr> result;
     for (std::string_view field : absl::StrSplit(token.value, '_')) {
+      if (field == "file") {
+        result.push_back(Expr{.field = Expr::kFile});
+        continue;
+      }
       int index = 0;
       if (!absl::SimpleAtoi(field, &index)) return std::nullopt;
       result.push_back(Expr{.field = index});
@@ -23,7 +23,8 @@ class Tokenizer {
     COMMA,
     TILDE,
     SQUOTED_STRING,
-    DQUOTED_STRING
+    DQUOTED_STRING,
+    NUMBER
   };
   struct Token {
     TokenType type;
@@ -45,6 +45,58 @@ TEST(SpecParserTest, CountDistinct) {
   EXPECT_EQ(ToString(Parse("cd2")), "count(distinct, _2)");
 }
 
+TEST(SpecParserTest, ApproxCountDistinct) {
+  EXPECT_EQ(ToString(Parse("count(approx_distinct, _1)")),
+            "count(approx_distinct, _1)");
+  EXPECT_EQ(ToString(Parse("count( approx_distinct, _1, 10 )")),
+            "count(approx_distinct, _1, 10)");
+  EXPECT_EQ(ToString(Parse("count(approx_distinct, _1, 14)")),
+            "count(approx_distinct, _1)");
+  EXPECT_EQ(ToString(Parse("acd3")), "count(approx_distinct, _3)");
+  EXPECT_EQ(ToString(Parse("acd3 cd3")),
+            "count(approx_distinct, _3) count(distinct, _3)");
+}
+
+TEST(SpecParserTest, Quantile) {
+  EXPECT_EQ(ToString(Parse("quantile(_5, 0.5)")), "quantile(_5, 0.5)");
+  EXPECT_EQ(ToString(Parse("quantile( _5,0.5, 0.99 ,0.999, 1 )")),
+            "quantile(_5, 0.5, 0.99, 0.999, 1)");
+}
+
+TEST(SpecParserTest, Histogram) {
+  EXPECT_EQ(ToString(Parse("hist(_5)")), "hist(_5)");
+  EXPECT_EQ(ToString(Parse("h5")), "hist(_5)");
+  EXPECT_EQ(ToString(Parse("hist(_5, 6)")), "hist(_5)");
+  EXPECT_EQ(ToString(Parse("hist(_5, 9)")), "hist(_5, 9)");
+  EXPECT_EQ(ToString(Parse("hist(_5,cumulative)")), "hist(_5, cumulative)");
+  EXPECT_EQ(ToString(Parse("hist(_5, 3, cumulative)")),
+            "hist(_5, 3, cumulative)");
+}
+
+TEST(SpecParserTest, Top) {
+  EXPECT_EQ(ToString(Parse("top(100) k1 c")), "top(100) key(_1) count");
+  EXPECT_EQ(ToString(Parse("c top( 5 ) key(_1) k2")),
+            "top(5) count key(_1) key(_2)");
+  EXPECT_EQ(ToString(Parse("top(5) k1 c => c")),
+            "top(5) key(_1) count => count");
+}
+
+TEST(SpecParserTest, Sort) {
+  EXPECT_EQ(ToString(Parse("k1 c sort(_2)")), "sort(_2) key(_1) count");
+  EXPECT_EQ(ToString(Parse("limit(10) k1 s2 sort(_2, desc)")),
+            "sort(_2, desc) limit(10) key(_1) sum(_2)");
+  EXPECT_EQ(ToString(Parse("top(50) k1 c sort(_3) limit(5)")),
+            "top(50) sort(_3) limit(5) key(_1) count");
+}
+
+TEST(SpecParserTest, File) {
+  EXPECT_EQ(ToString(Parse("key(_file) c")), "key(_file) count");
+  EXPECT_EQ(ToString(Parse("kfile k1 c")), "key(_file) key(_1) count");
+  EXPECT_EQ(ToString(Parse("k1 count(distinct, _file)")),
+            "key(_1) count(distinct, _file)");
+  EXPECT_EQ(ToString(Parse("k1 m3_file")), "key(_1) min(_3, _file)");
+}
+
 TEST(SpecParserTest, Filter) {
   EXPECT_EQ(ToString(Parse("filter(_1~FOO)")), "filter(_1~FOO)");
   EXPECT_EQ(ToString(Parse("f~FOO")), "filter(_0~FOO)");
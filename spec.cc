@@ -34,6 +34,7 @@ std::string ToString(const std::variant<T...>& value) {
 
 template <>
 std::string ToString(const Expr& expr) {
+  if (expr.field == Expr::kFile) return "_file";
   return absl::StrCat("_", expr.field);
 }
 
@@ -69,6 +70,34 @@ std::string ToString(const CountDistinct& cd) {
   return absl::StrCat("count(distinct, ", ToString(cd.what), ")");
 }
 
+template <>
+std::string ToString(const ApproxCountDistinct& acd) {
+  if (acd.precision == ApproxCountDistinct::kDefaultPrecision) {
+    return absl::StrCat("count(approx_distinct, ", ToString(acd.what), ")");
+  }
+  return absl::StrCat("count(approx_distinct, ", ToString(acd.what), ", ",
+                      acd.precision, ")");
+}
+
+template <>
+std::string ToString(const Quantile& q) {
+  std::string result = absl::StrCat("quantile(", ToString(q.what));
+  for (double quantile : q.quantiles) absl::StrAppend(&result, ", ", quantile);
+  result.push_back(')');
+  return result;
+}
+
+template <>
+std::string ToString(const Histogram& h) {
+  std::string result = absl::StrCat("hist(", ToString(h.what));
+  if (h.precision != Histogram::kDefaultPrecision) {
+    absl::StrAppend(&result, ", ", h.precision);
+  }
+  if (h.cumulative) result.append(", cumulative");
+  result.push_back(')');
+  return result;
+}
+
 template <>
 std::string ToString(const Filter& filter) {
   std::string escaped = filter.regexp.regexp;
@@ -81,10 +110,20 @@ std::string ToString(const Filter& filter) {
                       ")");
 }
 
+template <>
+std::string ToString(const Order& order) {
+  return absl::StrCat("sort(", ToString(order.by),
+                      order.descending ? ", desc)" : ")");
+}
+
 template <>
 std::string ToString(const AggregatedTable& table) {
-  return absl::StrCat(ToString(table.filters, {.trailer = " "}),
-                      ToString(table.components, {.delim = " "}));
+  return absl::StrCat(
+      ToString(table.filters, {.trailer = " "}),
+      table.top == 0 ? "" : absl::StrCat("top(", table.top, ") "),
+      table.order ? absl::StrCat(ToString(*table.order), " ") : "",
+      table.limit == 0 ? "" : absl::StrCat("limit(", table.limit, ") "),
+      ToString(table.components, {.delim = " "}));
 }
 
 template <>
@@ -1,6 +1,7 @@
 #ifndef GITHUB_ZISZIS_ZG_SPEC_INCLUDED
 #define GITHUB_ZISZIS_ZG_SPEC_INCLUDED
 
+#include <optional>
 #include <string>
 #include <vector>
 #include <variant>
@@ -12,6 +13,9 @@
 namespace spec {
 
 struct Expr {
+  // Name of the input file, written _file (see InputRow::kFileField).
+  static constexpr int kFile = -1;
+
   int field;
 };
 
@@ -39,6 +43,35 @@ struct CountDistinct {
   Expr what;
 };
 
+// Estimated with a HyperLogLog sketch of 2^precision registers.
+struct ApproxCountDistinct {
+  static constexpr int kMinPrecision = 4;
+  static constexpr int kMaxPrecision = 18;
+  static constexpr int kDefaultPrecision = 14;
+
+  Expr what;
+  int precision = kDefaultPrecision;
+};
+
+// One output column per quantile, each between 0 and 1.
+struct Quantile {
+  Expr what;
+  std::vector<double> quantiles;
+};
+
+// Counts of values in log-linear buckets, each at most 1 / 2^(precision - 1)
+// of its values wide; cumulative percentages instead of counts if
+// `cumulative`.
+struct Histogram {
+  static constexpr int kMinPrecision = 1;
+  static constexpr int kMaxPrecision = 12;
+  static constexpr int kDefaultPrecision = 6;
+
+  Expr what;
+  int precision = kDefaultPrecision;
+  bool cumulative = false;
+};
+
 struct Filter {
   struct RegexpMatch {
     Expr what;
@@ -47,10 +80,26 @@ struct Filter {
   RegexpMatch regexp;
 };
 
+// Output of a stage in order of the numeric values of one of its columns
+// (numbered from 1, as in the next stage).
+struct Order {
+  Expr by;
+  bool descending = false;
+};
+
 struct AggregatedTable {
-  using Component = std::variant<Key, Sum, Min, Max, Count, CountDistinct>;
+  using Component = std::variant<Key, Sum, Min, Max, Count, CountDistinct,
+                                 ApproxCountDistinct, Quantile, Histogram>;
   std::vector<Component> components;
   std::vector<Filter> filters;
+  // If non-zero, only keys and a count: the most frequent keys are counted
+  // approximately in this many counters, with an extra column for the error
+  // of every count (see heavy-hitters.h).
+  size_t top = 0;
+  // If set, output is ordered, and only the first `limit` lines of it are
+  // kept if that's non-zero (see ordered-output.h).
+  std::optional<Order> order;
+  size_t limit = 0;
 };
 
 struct SimpleTable {
@@ -0,0 +1,93 @@
+#include "spill.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "absl/strings/str_cat.h"
+#include "base.h"
+#include "varint.h"
+
+namespace {
+
+// Partition buffers are written out once they reach this size.
+constexpr size_t kBlockSize = 32 << 10;
+
+}  // namespace
+
+SpillFile::SpillFile() {
+  const char* dir = getenv("TMPDIR");
+  std::string path = absl::StrCat(dir && *dir ? dir : "/tmp", "/zg-XXXXXX");
+  fd_ = mkstemp(path.data());
+  if (fd_ < 0) {
+    Fail("Failed to create a spill file in ", Quoted(path), ": ",
+         std::strerror(errno));
+  }
+  unlink(path.c_str());
+}
+
+SpillFile::~SpillFile() {
+  mapped_.reset();
+  close(fd_);
+}
+
+void SpillFile::Add(size_t hash, std::string_view key,
+                    std::string_view state) {
+  if (key.size() > std::numeric_limits<uint32_t>::max()) {
+    Fail("Key too long, length=", key.size());
+  }
+  int partition = Partition(hash);
+  std::string& buf = buffers_[partition];
+  AppendVarint32(key.size(), &buf);
+  buf.append(key);
+  buf.append(state);
+  if (buf.size() >= kBlockSize) Flush(partition);
+}
+
+void SpillFile::Flush(int partition) {
+  std::string& buf = buffers_[partition];
+  if (buf.empty()) return;
+  blocks_[partition].push_back({size_, buf.size()});
+  const char* p = buf.data();
+  size_t left = buf.size();
+  while (left != 0) {
+    ssize_t written = write(fd_, p, left);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      Fail("Failed to write a spill file: ", std::strerror(errno));
+    }
+    p += written;
+    left -= written;
+  }
+  size_ += buf.size();
+  buf.clear();
+}
+
+void SpillFile::ForEach(
+    int partition,
+    const std::function<void(std::string_view, const char*&)>& fn) {
+  if (!mapped_) {
+    for (int i = 0; i < kNumPartitions; ++i) {
+      Flush(i);
+      std::string().swap(buffers_[i]);
+    }
+    if (lseek(fd_, 0, SEEK_SET) != 0 || !(mapped_ = MappedFile::Map(fd_))) {
+      Fail("Failed to map a spill file: ", std::strerror(errno));
+    }
+  }
+  for (const Block& block : blocks_[partition]) {
+    const char* p = mapped_->contents().data() + block.offset;
+    const char* end = p + block.size;
+    while (p != end) {
+      uint32_t len = ParseVarint32(p);
+      std::string_view key(p, len);
+      p += len;
+      fn(key, p);
+    }
+  }
+  std::vector<Block>().swap(blocks_[partition]);
+}
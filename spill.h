@@ -0,0 +1,142 @@
+#ifndef GITHUB_ZISZIS_ZG_SPILL_INCLUDED
+#define GITHUB_ZISZIS_ZG_SPILL_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hashed-key.h"
+#include "input.h"
+
+// Groups written out of a keyed table to keep it within a memory budget.
+// Groups are hash-partitioned, so that all spills of a table can be read
+// back and aggregated one partition at a time, taking 1/kNumPartitions of
+// the memory all groups would. Each partition is stored as blocks of
+// records in a single unlinked temporary file (under $TMPDIR or /tmp); a
+// record is the varint-prefixed key followed by the state as written by the
+// aggregator's Save().
+class SpillFile {
+ public:
+  static constexpr int kNumPartitions = 64;
+
+  SpillFile();
+  ~SpillFile();
+  SpillFile(const SpillFile&) = delete;
+  SpillFile& operator=(const SpillFile&) = delete;
+
+  static int Partition(size_t hash) {
+    // Bits above those hash tables probe by, so that a partition read back
+    // doesn't crowd its table, and below the topmost ones partitioned.h
+    // routes rows by (with the same hash), so that a partition's groups
+    // spread over all of these.
+    return (hash >> 48) % kNumPartitions;
+  }
+
+  void Add(size_t hash, std::string_view key, std::string_view state);
+
+  // Calls `fn(key, p)` for every record of `partition`, where `p` points to
+  // the saved state; `fn` must advance `p` past it. No records can be added
+  // afterwards.
+  void ForEach(int partition,
+               const std::function<void(std::string_view, const char*&)>& fn);
+
+ private:
+  struct Block {
+    size_t offset;
+    size_t size;
+  };
+
+  void Flush(int partition);
+
+  int fd_;
+  size_t size_ = 0;
+  std::string buffers_[kNumPartitions];
+  std::vector<Block> blocks_[kNumPartitions];
+  std::unique_ptr<MappedFile> mapped_;
+};
+
+// Spills the groups of a HashedKeyMap<Aggregator::State> into a SpillFile
+// whenever they take more than `max_memory` bytes (0 means no limit), and
+// brings them back when the table is finished.
+template <class Aggregator>
+class GroupSpiller {
+ public:
+  using State = typename Aggregator::State;
+
+  // `aggregator` is the one updating the table's groups; a copy of it loads
+  // spilled states.
+  GroupSpiller(size_t max_memory, const Aggregator& aggregator)
+      : max_memory_(max_memory), loader_(aggregator) {}
+
+  size_t max_memory() const { return max_memory_; }
+
+  void MaybeSpill(HashedKeyMap<State>& groups, Aggregator& aggregator) {
+    if (max_memory_ != 0 &&
+        groups.MemoryUsage() + aggregator.MemoryUsage() > max_memory_) {
+      Spill(groups, aggregator);
+    }
+  }
+
+  // Takes over groups spilled by `other`, which belongs to a fork being
+  // merged into the table.
+  void Adopt(GroupSpiller& other) {
+    for (auto& file : other.files_) files_.push_back(std::move(file));
+    other.files_.clear();
+    other.own_ = nullptr;
+  }
+
+  // Calls `print()` to print all of `groups`. If any were spilled, this
+  // happens once per partition, with `groups` holding just that partition,
+  // and `groups` is left empty.
+  template <class Print>
+  void Finish(HashedKeyMap<State>& groups, Aggregator& aggregator,
+              Print print) {
+    if (files_.empty()) return print();
+    Spill(groups, aggregator);
+    for (int partition = 0; partition < SpillFile::kNumPartitions;
+         ++partition) {
+      for (const auto& file : files_) {
+        file->ForEach(partition, [&](std::string_view key, const char*& p) {
+          State from = loader_.Load(p);
+          groups.InsertOrUpdate(
+              HashedKey(key), [&] { return aggregator.Copy(loader_, from); },
+              [&](State& state) { aggregator.Merge(loader_, from, state); });
+          // Loaded states are only needed until merged, and may be large.
+          if (loader_.MemoryUsage() > max_memory_) loader_.Reset();
+        });
+        loader_.Reset();
+      }
+      print();
+      groups.clear();
+      aggregator.Reset();
+    }
+    files_.clear();
+    own_ = nullptr;
+  }
+
+ private:
+  void Spill(HashedKeyMap<State>& groups, Aggregator& aggregator) {
+    if (!own_) {
+      files_.push_back(std::make_unique<SpillFile>());
+      own_ = files_.back().get();
+    }
+    for (const auto& [key, value] : groups) {
+      buf_.clear();
+      aggregator.Save(value, &buf_);
+      own_->Add(key.hash, key.value(), buf_);
+    }
+    groups.clear();
+    aggregator.Reset();
+  }
+
+  size_t max_memory_;
+  Aggregator loader_;
+  std::vector<std::unique_ptr<SpillFile>> files_;
+  // The file this table spills into, one of files_.
+  SpillFile* own_ = nullptr;
+  std::string buf_;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_SPILL_INCLUDED
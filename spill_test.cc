@@ -0,0 +1,150 @@
+#include "spill.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "aggregators.h"
+#include "dense-key.h"
+#include "gtest/gtest.h"
+#include "output.h"
+
+TEST(SpillFile, ReadsBackByPartition) {
+  SpillFile file;
+  std::map<std::string, int64_t> added;
+  for (int64_t i = 0; i < 100000; ++i) {
+    std::string key = absl::StrCat("key", i);
+    file.Add(HashedKey::Hash(key), key,
+             std::string_view(reinterpret_cast<const char*>(&i), sizeof(i)));
+    added[key] = i;
+  }
+
+  std::map<std::string, int64_t> read;
+  for (int partition = 0; partition < SpillFile::kNumPartitions;
+       ++partition) {
+    file.ForEach(partition, [&](std::string_view key, const char*& p) {
+      EXPECT_EQ(SpillFile::Partition(HashedKey::Hash(key)), partition);
+      int64_t value;
+      memcpy(&value, p, sizeof(value));
+      p += sizeof(value);
+      EXPECT_TRUE(read.emplace(key, value).second);
+    });
+  }
+  EXPECT_EQ(read, added);
+}
+
+TEST(GroupSpiller, MergesSpilledGroups) {
+  CountAggregator aggregator(0);
+  GroupSpiller<CountAggregator> spiller(/*max_memory=*/4096, aggregator);
+  HashedKeyMap<int64_t> groups;
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 10000; ++i) {
+      groups.InsertOrUpdate(
+          HashedKey(absl::StrCat("key", i)), [] { return int64_t{1}; },
+          [](int64_t& count) { ++count; });
+      spiller.MaybeSpill(groups, aggregator);
+    }
+  }
+
+  std::map<std::string, int64_t> printed;
+  int num_prints = 0;
+  spiller.Finish(groups, aggregator, [&] {
+    ++num_prints;
+    for (const auto& [key, count] : groups) {
+      EXPECT_TRUE(printed.emplace(key.value(), count).second);
+    }
+  });
+  EXPECT_EQ(num_prints, SpillFile::kNumPartitions);
+  ASSERT_EQ(printed.size(), 10000);
+  for (const auto& [key, count] : printed) EXPECT_EQ(count, 3) << key;
+  EXPECT_EQ(groups.size(), 0);
+}
+
+// Counts rows, pretending each one takes a kilobyte of the aggregator's
+// memory, and counts states saved into a spill file.
+class HeavyCountAggregator {
+ public:
+  using State = int64_t;
+
+  explicit HeavyCountAggregator(int* saves) : saves_(saves) {}
+
+  State Init(const InputRow&) {
+    ++rows_;
+    return 1;
+  }
+  void Update(const InputRow&, State& state) {
+    ++rows_;
+    ++state;
+  }
+  State Copy(const HeavyCountAggregator&, State from) {
+    rows_ += from;
+    return from;
+  }
+  void Merge(const HeavyCountAggregator&, State from, State& state) {
+    rows_ += from;
+    state += from;
+  }
+  void Print(State state, OutputTable& out) const {
+    out.SetNumber(1, Numeric(state));
+  }
+  void Reset() { rows_ = 0; }
+  void Save(State state, std::string* out) const {
+    ++*saves_;
+    out->append(reinterpret_cast<const char*>(&state), sizeof(state));
+  }
+  State Load(const char*& p) {
+    State state;
+    memcpy(&state, p, sizeof(state));
+    p += sizeof(state);
+    rows_ += state;
+    return state;
+  }
+  size_t MemoryUsage() const { return rows_ * 1024; }
+
+ private:
+  int* saves_;
+  int64_t rows_ = 0;
+};
+
+// Collects counts by key.
+class CollectingTable : public OutputTable {
+ public:
+  explicit CollectingTable(std::map<std::string, int64_t>* counts)
+      : OutputTable(2), counts_(counts) {}
+  void EndLine() override {
+    (*counts_)[std::string(Text(0))] += std::stoll(std::string(Text(1)));
+  }
+  void Finish() override {}
+
+ private:
+  std::map<std::string, int64_t>* counts_;
+};
+
+TEST(DenseKeyTable, SpillsFewLargeGroups) {
+  // A handful of keys, dense or not, whose states keep growing, as those of
+  // count(distinct) do.
+  for (const std::vector<std::string>& keys :
+       {std::vector<std::string>{"1", "2", "3"},
+        std::vector<std::string>{"a", "b", "c"}}) {
+    int saves = 0;
+    std::map<std::string, int64_t> printed;
+    DenseKeyTable<HeavyCountAggregator> table(
+        Table::Key(1, 0), HeavyCountAggregator(&saves),
+        std::make_unique<CollectingTable>(&printed),
+        /*max_memory=*/1 << 20);
+    std::map<std::string, int64_t> expected;
+    InputRow row;
+    for (int i = 0; i < 10000; ++i) {
+      const std::string& key = keys[i % keys.size()];
+      row.Reset(key);
+      table.PushRow(row);
+      ++expected[key];
+    }
+    table.Finish();
+    EXPECT_GT(saves, 0) << keys[0];
+    EXPECT_EQ(printed, expected);
+  }
+}
@@ -0,0 +1,153 @@
+#include "split.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void SplitScalar(std::string_view line, size_t max_fields,
+                 std::vector<std::string_view>* fields) {
+  const char* begin = line.data();
+  const char* end = begin + line.size();
+  while (fields->size() < max_fields) {
+    while (true) {
+      if (begin == end) return;
+      if (*begin != ' ' && *begin != '\t') break;
+      ++begin;
+    }
+    const char* p = begin;
+    while (true) {
+      if (p == end) {
+        fields->emplace_back(begin, p - begin);
+        return;
+      }
+      if (*p == ' ' || *p == '\t') {
+        fields->emplace_back(begin, p - begin);
+        begin = p + 1;
+        break;
+      }
+      ++p;
+    }
+  }
+}
+
+// Vectorized splitting: `Mask(p)` returns a bitmask of separators among the
+// 64 bytes at p. Field boundaries are the bits where the mask differs from
+// itself shifted by one position, and they always alternate between field
+// starts and ends. The tail of the line is padded with separators, which
+// terminates the last field.
+template <uint64_t (*Mask)(const char*)>
+inline void SplitWithMask(std::string_view line, size_t max_fields,
+                          std::vector<std::string_view>* fields) {
+  if (fields->size() >= max_fields) return;
+  const char* data = line.data();
+  size_t size = line.size();
+  uint64_t carry = 1;  // Line start acts as if preceded by a separator.
+  size_t field_begin = 0;
+
+  // Returns false once there's enough fields.
+  auto process = [&](uint64_t sep, size_t offset) {
+    uint64_t boundaries = sep ^ ((sep << 1) | carry);
+    carry = sep >> 63;
+    while (boundaries != 0) {
+      int i = __builtin_ctzll(boundaries);
+      boundaries &= boundaries - 1;
+      if ((sep >> i) & 1) {
+        fields->emplace_back(data + field_begin, offset + i - field_begin);
+        if (fields->size() >= max_fields) return false;
+      } else {
+        field_begin = offset + i;
+      }
+    }
+    return true;
+  };
+
+  size_t offset = 0;
+  for (; offset + 64 <= size; offset += 64) {
+    if (!process(Mask(data + offset), offset)) return;
+  }
+  char tail[64];
+  std::memset(tail, ' ', sizeof(tail));
+  std::memcpy(tail, data + offset, size - offset);
+  process(Mask(tail), offset);
+}
+
+#if defined(__x86_64__)
+
+inline uint64_t SeparatorMaskSse2(const char* p) {
+  const __m128i spaces = _mm_set1_epi8(' ');
+  const __m128i tabs = _mm_set1_epi8('\t');
+  uint64_t result = 0;
+  for (int i = 0; i < 4; ++i) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+    __m128i sep = _mm_or_si128(_mm_cmpeq_epi8(v, spaces),
+                               _mm_cmpeq_epi8(v, tabs));
+    result |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(sep))}
+              << (16 * i);
+  }
+  return result;
+}
+
+// `flatten` makes sure the whole loop, including the mask computation, is
+// inlined into a single function.
+__attribute__((flatten)) void SplitSse2(
+    std::string_view line, size_t max_fields,
+    std::vector<std::string_view>* fields) {
+  SplitWithMask<SeparatorMaskSse2>(line, max_fields, fields);
+}
+
+__attribute__((target("avx2"))) inline uint64_t SeparatorMaskAvx2(
+    const char* p) {
+  const __m256i spaces = _mm256_set1_epi8(' ');
+  const __m256i tabs = _mm256_set1_epi8('\t');
+  __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+  uint32_t lo_mask = _mm256_movemask_epi8(_mm256_or_si256(
+      _mm256_cmpeq_epi8(lo, spaces), _mm256_cmpeq_epi8(lo, tabs)));
+  uint32_t hi_mask = _mm256_movemask_epi8(_mm256_or_si256(
+      _mm256_cmpeq_epi8(hi, spaces), _mm256_cmpeq_epi8(hi, tabs)));
+  return lo_mask | (uint64_t{hi_mask} << 32);
+}
+
+// Same as above, and the loop has to be compiled for AVX2 as a whole.
+__attribute__((target("avx2"), flatten)) void SplitAvx2(
+    std::string_view line, size_t max_fields,
+    std::vector<std::string_view>* fields) {
+  SplitWithMask<SeparatorMaskAvx2>(line, max_fields, fields);
+}
+
+#endif  // defined(__x86_64__)
+
+internal::SplitFn ChooseSplitFn() {
+  std::vector<std::pair<std::string_view, internal::SplitFn>> impls =
+      internal::SplitImplementations();
+  return impls.back().second;
+}
+
+}  // namespace
+
+void SplitFields(std::string_view line, size_t max_fields,
+                 std::vector<std::string_view>* fields) {
+  static const internal::SplitFn split = ChooseSplitFn();
+  split(line, max_fields, fields);
+}
+
+namespace internal {
+
+std::vector<std::pair<std::string_view, SplitFn>> SplitImplementations() {
+  std::vector<std::pair<std::string_view, SplitFn>> result = {
+      {"scalar", &SplitScalar}};
+#if defined(__x86_64__)
+  result.emplace_back("sse2", &SplitSse2);
+  if (__builtin_cpu_supports("avx2")) {
+    result.emplace_back("avx2", &SplitAvx2);
+  }
+#endif
+  return result;
+}
+
+}  // namespace internal
@@ -0,0 +1,26 @@
+#ifndef GITHUB_ZISZIS_ZG_SPLIT_INCLUDED
+#define GITHUB_ZISZIS_ZG_SPLIT_INCLUDED
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Splits `line` into fields separated by runs of spaces and tabs, appends
+// them to `fields`. Stops as soon as `fields` has `max_fields` elements, so
+// the rest of the line isn't even looked at. Uses the widest vector
+// instructions the CPU supports.
+void SplitFields(std::string_view line, size_t max_fields,
+                 std::vector<std::string_view>* fields);
+
+namespace internal {
+
+using SplitFn = void (*)(std::string_view, size_t,
+                        std::vector<std::string_view>*);
+
+// All implementations usable on this CPU, the plain scalar loop first and
+// the one used by SplitFields() last. Only exposed for tests and benchmarks.
+std::vector<std::pair<std::string_view, SplitFn>> SplitImplementations();
+
+}  // namespace internal
+
+#endif  // GITHUB_ZISZIS_ZG_SPLIT_INCLUDED
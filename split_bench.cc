@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "base.h"
+#include "split.h"
+
+// Lines of `num_fields` fields, `field_length` characters each on average.
+std::string MakeLines(int num_lines, int num_fields, int field_length) {
+  std::mt19937 e(42);
+  std::uniform_int_distribution<int> length(1, 2 * field_length - 1);
+  std::string result;
+  for (int i = 0; i < num_lines; ++i) {
+    for (int j = 0; j < num_fields; ++j) {
+      if (j != 0) result.push_back(j % 4 == 0 ? '\t' : ' ');
+      result.append(length(e), 'a' + j % 26);
+    }
+    result.push_back('\n');
+  }
+  return result;
+}
+
+// Args: implementation index (see SplitImplementations()), number of fields
+// and average field length.
+static void BM_Split(benchmark::State& state) {
+  auto impls = internal::SplitImplementations();
+  if (static_cast<size_t>(state.range(0)) >= impls.size()) {
+    state.SkipWithError("not supported by the CPU");
+    return;
+  }
+  auto [name, split] = impls[state.range(0)];
+  state.SetLabel(std::string(name));
+
+  std::string text = MakeLines(1000, state.range(1), state.range(2));
+  std::vector<std::string_view> lines;
+  for (size_t begin = 0; begin < text.size();) {
+    size_t end = text.find('\n', begin);
+    lines.emplace_back(text.data() + begin, end - begin);
+    begin = end + 1;
+  }
+
+  std::vector<std::string_view> fields;
+  for (auto _ : state) {
+    for (std::string_view line : lines) {
+      fields.clear();
+      split(line, SIZE_MAX, &fields);
+      benchmark::DoNotOptimize(fields.data());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+  state.SetItemsProcessed(state.iterations() * lines.size());
+}
+static void SplitArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"impl", "fields", "len"});
+  for (int impl = 0; impl < 3; ++impl) {
+    b->Args({impl, 5, 4});    // short lines
+    b->Args({impl, 5, 100});  // long lines
+    b->Args({impl, 40, 8});   // wide lines
+  }
+}
+BENCHMARK(BM_Split)->Apply(SplitArgs);
@@ -0,0 +1,72 @@
+#include "split.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+std::vector<std::string_view> Split(internal::SplitFn split,
+                                    std::string_view line,
+                                    size_t max_fields = SIZE_MAX) {
+  std::vector<std::string_view> result;
+  split(line, max_fields, &result);
+  return result;
+}
+
+TEST(SplitFields, Smoke) {
+  std::vector<std::string_view> fields;
+  SplitFields(" foo\tbar  \t baz ", SIZE_MAX, &fields);
+  EXPECT_EQ(fields, (std::vector<std::string_view>{"foo", "bar", "baz"}));
+}
+
+TEST(SplitFields, Edges) {
+  for (const auto& [name, split] : internal::SplitImplementations()) {
+    SCOPED_TRACE(name);
+    EXPECT_TRUE(Split(split, "").empty());
+    EXPECT_TRUE(Split(split, "  \t ").empty());
+    EXPECT_EQ(Split(split, "x"), std::vector<std::string_view>{"x"});
+
+    std::string long_field(200, 'x');
+    EXPECT_EQ(Split(split, long_field),
+              std::vector<std::string_view>{long_field});
+
+    // Fields ending and starting right at 64-byte block boundaries.
+    std::string line = std::string(63, 'a') + " " + std::string(64, 'b');
+    EXPECT_EQ(Split(split, line), (std::vector<std::string_view>{
+                                      std::string_view(line).substr(0, 63),
+                                      std::string_view(line).substr(64)}));
+  }
+}
+
+TEST(SplitFields, MaxFields) {
+  std::string line = std::string(100, 'a') + " b c";
+  for (const auto& [name, split] : internal::SplitImplementations()) {
+    SCOPED_TRACE(name);
+    EXPECT_TRUE(Split(split, "a b", 0).empty());
+    EXPECT_EQ(Split(split, "a b c", 2),
+              (std::vector<std::string_view>{"a", "b"}));
+    EXPECT_EQ(Split(split, line, 1), std::vector<std::string_view>{
+                                         std::string_view(line).substr(0, 100)});
+    EXPECT_EQ(Split(split, line, 5).size(), 3);
+  }
+}
+
+TEST(SplitFields, MatchesScalar) {
+  auto impls = internal::SplitImplementations();
+  std::mt19937 rnd(42);
+  for (int i = 0; i < 10000; ++i) {
+    std::string line(rnd() % 300, 'x');
+    for (char& c : line) {
+      switch (rnd() % 4) {
+        case 0: c = ' '; break;
+        case 1: c = '\t'; break;
+        default: c = 'a' + rnd() % 26;
+      }
+    }
+    size_t max_fields = rnd() % 2 ? SIZE_MAX : rnd() % 10;
+    auto expected = Split(impls[0].second, line, max_fields);
+    for (const auto& [name, split] : impls) {
+      ASSERT_EQ(Split(split, line, max_fields), expected)
+          << name << ": " << line;
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef GITHUB_ZISZIS_ZG_SPSC_QUEUE_INCLUDED
+#define GITHUB_ZISZIS_ZG_SPSC_QUEUE_INCLUDED
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. Slots are allocated once and reused: the producer fills the slot
+// returned by BeginPush() in place and publishes it with EndPush(), the
+// consumer reads the slot returned by BeginPop() and hands it back with
+// EndPop(), so their memory (e.g. a string's buffer) is recycled.
+//
+// A full queue blocks the producer until the consumer catches up, so a slow
+// consumer holds up its producer rather than letting memory grow.
+template <class T>
+class SpscQueue {
+ public:
+  // `capacity` is rounded up to a power of 2.
+  explicit SpscQueue(size_t capacity) : slots_(std::bit_ceil(capacity)) {}
+
+  // Blocks while the queue is full.
+  T* BeginPush() {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (tail - head == slots_.size()) {
+      head_.wait(head, std::memory_order_acquire);
+      head = head_.load(std::memory_order_acquire);
+    }
+    return &slots_[tail & (slots_.size() - 1)];
+  }
+  void EndPush() {
+    tail_.fetch_add(1, std::memory_order_release);
+    tail_.notify_one();
+  }
+  // No more pushes.
+  void Close() {
+    tail_.fetch_or(kClosed, std::memory_order_release);
+    tail_.notify_one();
+  }
+
+  // Blocks while the queue is empty, returns nullptr once it's closed and
+  // drained.
+  T* BeginPop() {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    while ((tail & ~kClosed) == head) {
+      if (tail & kClosed) return nullptr;
+      tail_.wait(tail, std::memory_order_acquire);
+      tail = tail_.load(std::memory_order_acquire);
+    }
+    return &slots_[head & (slots_.size() - 1)];
+  }
+  void EndPop() {
+    head_.fetch_add(1, std::memory_order_release);
+    head_.notify_one();
+  }
+
+ private:
+  static constexpr uint64_t kClosed = uint64_t{1} << 63;
+
+  std::vector<T> slots_;
+  // Number of slots popped (written by the consumer only) and pushed (by the
+  // producer, along with kClosed), on separate cache lines.
+  alignas(64) std::atomic<uint64_t> head_ = 0;
+  alignas(64) std::atomic<uint64_t> tail_ = 0;
+};
+
+#endif  // GITHUB_ZISZIS_ZG_SPSC_QUEUE_INCLUDED
@@ -0,0 +1,43 @@
+#include "spsc-queue.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+TEST(SpscQueue, Smoke) {
+  SpscQueue<int> queue(3);
+  for (int i = 0; i < 4; ++i) {
+    *queue.BeginPush() = i;
+    queue.EndPush();
+  }
+  queue.Close();
+  for (int i = 0; i < 4; ++i) {
+    int* slot = queue.BeginPop();
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ(*slot, i);
+    queue.EndPop();
+  }
+  EXPECT_EQ(queue.BeginPop(), nullptr);
+}
+
+TEST(SpscQueue, PassesAllItemsInOrder) {
+  constexpr int kItems = 1'000'000;
+  SpscQueue<std::vector<int>> queue(4);
+  std::thread producer([&] {
+    for (int i = 0; i < kItems; ++i) {
+      std::vector<int>* slot = queue.BeginPush();
+      slot->assign(i % 7, i);
+      queue.EndPush();
+    }
+    queue.Close();
+  });
+  int next = 0;
+  while (const std::vector<int>* slot = queue.BeginPop()) {
+    ASSERT_EQ(slot->size(), next % 7);
+    for (int v : *slot) ASSERT_EQ(v, next);
+    ++next;
+    queue.EndPop();
+  }
+  producer.join();
+  EXPECT_EQ(next, kItems);
+}
@@ -0,0 +1,124 @@
+#include "stage-thread.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc-queue.h"
+
+namespace {
+
+// Batches in flight between two stages.
+constexpr size_t kQueueSize = 8;
+
+// Lines of a batch, each of `num_columns` cells.
+struct Lines {
+  void Clear() {
+    text.clear();
+    ends.clear();
+    numbers.clear();
+    is_number.clear();
+  }
+
+  // Text cells one after another, ends[i] is where cell i ends (numbers take
+  // no text).
+  std::string text;
+  std::vector<uint32_t> ends;
+  std::vector<Numeric> numbers;
+  std::vector<char> is_number;
+};
+
+class ThreadedPipeTable : public OutputTable {
+ public:
+  ThreadedPipeTable(int num_columns, std::unique_ptr<Table> table,
+                    int max_field)
+      : OutputTable(num_columns),
+        table_(std::move(table)),
+        queue_(kQueueSize),
+        worker_([this, max_field] { Run(max_field); }) {}
+
+  ~ThreadedPipeTable() {
+    if (worker_.joinable()) {
+      queue_.Close();
+      worker_.join();
+    }
+  }
+
+  void EndLine() override {
+    if (lines_ == nullptr) {
+      lines_ = queue_.BeginPush();
+      lines_->Clear();
+    }
+    for (int i = 0; i < columns_.size(); ++i) {
+      if (is_number_[i]) {
+        lines_->numbers.push_back(numbers_[i]);
+      } else {
+        lines_->text.append(columns_[i]);
+        lines_->numbers.emplace_back();
+      }
+      lines_->ends.push_back(lines_->text.size());
+      lines_->is_number.push_back(is_number_[i]);
+    }
+    if (lines_->is_number.size() == Table::kBatchSize * columns_.size()) {
+      queue_.EndPush();
+      lines_ = nullptr;
+    }
+  }
+
+  void Finish() override {
+    if (lines_ != nullptr) {
+      queue_.EndPush();
+      lines_ = nullptr;
+    }
+    finish_ = true;
+    queue_.Close();
+    worker_.join();
+  }
+
+ private:
+  void Run(int max_field) {
+    std::vector<InputRow> rows(Table::kBatchSize, InputRow(max_field));
+    std::vector<const InputRow*> batch;
+    std::vector<std::string_view> cells;
+    size_t num_columns = columns_.size();
+    while (const Lines* lines = queue_.BeginPop()) {
+      size_t num_cells = lines->is_number.size();
+      cells.resize(num_cells);
+      uint32_t begin = 0;
+      for (size_t i = 0; i < num_cells; ++i) {
+        cells[i] = std::string_view(lines->text.data() + begin,
+                                    lines->ends[i] - begin);
+        begin = lines->ends[i];
+      }
+      batch.clear();
+      for (size_t first = 0; first < num_cells; first += num_columns) {
+        InputRow& row = rows[batch.size()];
+        row.Reset(std::span(cells).subspan(first, num_columns),
+                  std::span(lines->numbers).subspan(first, num_columns),
+                  std::span(lines->is_number).subspan(first, num_columns));
+        batch.push_back(&row);
+      }
+      table_->PushBatch(batch);
+      queue_.EndPop();
+    }
+    if (finish_) table_->Finish();
+  }
+
+  std::unique_ptr<Table> table_;
+  SpscQueue<Lines> queue_;
+  // The batch being filled, if any.
+  Lines* lines_ = nullptr;
+  // Set before the queue is closed by Finish(), rather than the destructor.
+  std::atomic<bool> finish_ = false;
+  std::thread worker_;
+};
+
+}  // namespace
+
+std::unique_ptr<OutputTable> MakeThreadedPipeTable(int num_columns,
+                                                   std::unique_ptr<Table> table,
+                                                   int max_field) {
+  return std::make_unique<ThreadedPipeTable>(num_columns, std::move(table),
+                                             max_field);
+}
@@ -0,0 +1,22 @@
+#ifndef GITHUB_ZISZIS_ZG_STAGE_THREAD_INCLUDED
+#define GITHUB_ZISZIS_ZG_STAGE_THREAD_INCLUDED
+
+#include <memory>
+
+#include "output.h"
+#include "table.h"
+
+// Same as MakePipeTable(), but `table` runs on a thread of its own. Lines
+// are copied into batches of Table::kBatchSize rows (numbers as they are),
+// which go through a bounded single-producer single-consumer queue (see
+// spsc-queue.h), so a stage producing lines waits when the next one falls
+// behind.
+//
+// Finish() waits for `table` to take all lines and finish, which happens on
+// its thread too: in a pipeline of such stages, every stage finishes on its
+// own thread while the next one is already busy with the lines.
+std::unique_ptr<OutputTable> MakeThreadedPipeTable(int num_columns,
+                                                   std::unique_ptr<Table> table,
+                                                   int max_field);
+
+#endif  // GITHUB_ZISZIS_ZG_STAGE_THREAD_INCLUDED
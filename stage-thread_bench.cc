@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "absl/strings/str_cat.h"
+#include "options.h"
+#include "pipeline.h"
+#include "row-batch.h"
+#include "spec-parser.h"
+
+// A 3-stage pipeline with many groups passed between the stages, pushed
+// through the way zg does, with stages on the same thread or on their own.
+// The last stage swallows all lines, so nothing is printed.
+//
+// Args: stage threads (0 or 1), number of distinct keys.
+static void BM_ThreeStages(benchmark::State& state) {
+  Options options;
+  options.stage_threads = state.range(0);
+  state.SetLabel(state.range(0) ? "stage threads" : "one thread");
+  size_t num_distinct = state.range(1);
+  size_t num_rows = 2 * num_distinct;
+  constexpr size_t kBlockRows = 1 << 16;
+
+  std::mt19937_64 e(42);
+  std::uniform_int_distribution<size_t> dist(0, num_distinct - 1);
+  std::string block;
+  for (auto _ : state) {
+    int max_field;
+    std::unique_ptr<Table> table = BuildPipeline(
+        spec::Parse("k1 k2 s3 => k1 c s3 M3 => f4~x"), options, &max_field);
+    RowBatcher batcher(max_field);
+    for (size_t begin = 0; begin < num_rows; begin += kBlockRows) {
+      state.PauseTiming();
+      block.clear();
+      for (size_t i = begin; i < std::min(begin + kBlockRows, num_rows);
+           ++i) {
+        size_t key = dist(e);
+        absl::StrAppend(&block, "key", key * 7919, " ", key % 3, " ",
+                        i % 100, "\n");
+      }
+      state.ResumeTiming();
+      batcher.PushLines(block.data(), block.data() + block.size(), *table);
+    }
+    table->Finish();
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows);
+}
+BENCHMARK(BM_ThreeStages)
+    ->ArgsProduct({{0, 1}, {100'000, 1'000'000, 10'000'000}})
+    ->Unit(benchmark::kMillisecond);
@@ -54,6 +54,31 @@ void MultiColumnDynamicStorage::Update(Handle handle, const InputRow& row) {
   stg_.Update(handle, Serialize(row));
 }
 
+MultiColumnDynamicStorage::Handle MultiColumnDynamicStorage::Store(
+    const MultiColumnDynamicStorage& from, Handle from_handle) {
+  return stg_.Store(from.stg_.Load(from_handle));
+}
+
+void MultiColumnDynamicStorage::Update(Handle handle,
+                                       const MultiColumnDynamicStorage& from,
+                                       Handle from_handle) {
+  stg_.Update(handle, from.stg_.Load(from_handle));
+}
+
+void MultiColumnDynamicStorage::Save(Handle handle, std::string* out) const {
+  std::string_view value = stg_.Load(handle);
+  AppendVarint32(value.size(), out);
+  out->append(value);
+}
+
+MultiColumnDynamicStorage::Handle MultiColumnDynamicStorage::Load(
+    const char*& p) {
+  uint32_t len = ParseVarint32(p);
+  Handle result = stg_.Store(std::string_view(p, len));
+  p += len;
+  return result;
+}
+
 void MultiColumnDynamicStorage::Print(Handle handle, OutputTable& out) const {
   std::string_view value = stg_.Load(handle);
   if (columns_.size() == 1) {
@@ -16,6 +16,9 @@ class DynamicStorage {
   void Update(Handle handle, std::string_view new_data);
   std::string_view Load(Handle handle) const;
   void Reset();
+  size_t MemoryUsage() const {
+    return storage_.capacity() + offsets_.capacity() * sizeof(uint64_t);
+  }
 
  private:
   std::string storage_;
@@ -31,8 +34,21 @@ class MultiColumnDynamicStorage {
 
   Handle Store(const InputRow& row);
   void Update(Handle handle, const InputRow& row);
+
+  // Same as above, but take the value stored in another storage with the same
+  // columns.
+  Handle Store(const MultiColumnDynamicStorage& from, Handle from_handle);
+  void Update(Handle handle, const MultiColumnDynamicStorage& from,
+              Handle from_handle);
+
   void Print(Handle handle, OutputTable& out) const;
   void Reset() { stg_.Reset(); }
+  size_t MemoryUsage() const { return stg_.MemoryUsage(); }
+
+  // Serialization of stored values for spilling to disk: Save() appends the
+  // value to `out`, Load() stores a saved value and advances `p` past it.
+  void Save(Handle handle, std::string* out) const;
+  Handle Load(const char*& p);
 
  private:
   std::string_view Serialize(const InputRow& row) const;
@@ -1,6 +1,9 @@
 #ifndef GITHUB_ZISZIS_ZG_TABLE_INCLUDED
 #define GITHUB_ZISZIS_ZG_TABLE_INCLUDED
 
+#include <memory>
+#include <span>
+
 #include "types.h"
 
 class Table {
@@ -11,9 +14,55 @@ class Table {
     int column;
   };
 
+  // Rows are pushed in batches of at most this many rows.
+  static constexpr size_t kBatchSize = 1024;
+  using Batch = std::span<const InputRow* const>;
+
   virtual ~Table() {}
   virtual void PushRow(const InputRow& row) = 0;
   virtual void Finish() = 0;
+
+  // Same as PushRow() for each row, but lets tables run tight loops over the
+  // batch instead of paying for a virtual call (and more) on every row.
+  virtual void PushBatch(Batch rows) {
+    for (const InputRow* row : rows) PushRow(*row);
+  }
+
+  // Parallel aggregation support. Fork() returns an empty table of the same
+  // shape which doesn't produce any output (nullptr if the table can't be
+  // aggregated in parallel). Rows can be pushed into forks concurrently, and
+  // then the state accumulated by a fork is absorbed by Merge(), which leaves
+  // the fork empty.
+  virtual std::unique_ptr<Table> Fork() const { return nullptr; }
+  virtual void Merge(Table& fork) { LogicError("merge into unforkable table"); }
 };
 
+// How a stage aggregates its groups, as opposed to what it computes.
+struct AggregationOptions {
+  // The input is sorted by the keys (see sorted-key.h).
+  bool sorted = false;
+  // Bytes the groups may take before they're spilled to disk (see spill.h),
+  // 0 means no limit.
+  size_t max_memory = 0;
+  // Groups are found by sorting all rows by key hash (see radix-key.h)
+  // rather than in a hash table. Never spills, so max_memory is ignored.
+  bool sort_by_hash = false;
+  // Threads a table may use on its own, e.g. for sorting.
+  int threads = 1;
+};
+
+// Calls `aggregator.Update()` for every row with the corresponding state, or
+// the aggregator's own UpdateBatch() if it has one.
+template <class Aggregator, class State>
+void UpdateBatch(Aggregator& aggregator, Table::Batch rows,
+                 std::span<State* const> states) {
+  if constexpr (requires { aggregator.UpdateBatch(rows, states); }) {
+    aggregator.UpdateBatch(rows, states);
+  } else {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      aggregator.Update(*rows[i], *states[i]);
+    }
+  }
+}
+
 #endif  // GITHUB_ZISZIS_ZG_TABLE_INCLUDED
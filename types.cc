@@ -1,7 +1,12 @@
 #include "types.h"
 
+#include <cstring>
+
 #include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
 #include "base.h"
+#include "split.h"
 
 template <>
 int64_t ParseAs<>(const FieldValue& field) {
@@ -31,36 +36,153 @@ std::optional<int64_t> TryParseAs<>(const FieldValue& field) {
   }
 }
 
-// Splits line_ into fields_, separated by one or more of tabs/spaces.
-void InputRow::SplitLine() const {
-  const char* begin = line_.data();
-  const char* end = begin + line_.size();
-  while (true) {
-    while (true) {
-      if (begin == end) return;
-      if (*begin != ' ' && *begin != '\t') break;
-      ++begin;
-    }
-    const char* p = begin;
-    while (true) {
-      if (p == end) {
-        fields_.emplace_back(std::string_view(begin, p - begin));
+namespace {
+
+template <class T>
+bool UpdateMin(T& min, T v) {
+  if (v < min) {
+    min = v;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+template <class T>
+bool UpdateMax(T& max, T v) {
+  if (v > max) {
+    max = v;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+template <class V>
+inline bool SumOverflows(V a, V b) {
+  return (a > 0 && b > std::numeric_limits<V>::max() - a) ||
+         (a < 0 && b > std::numeric_limits<V>::lowest() - a);
+}
+
+inline double AsDouble(std::variant<int64_t, double> n) {
+  return std::visit([](auto v) { return static_cast<double>(v); }, n);
+}
+
+}  // namespace
+
+Numeric Numeric::Make(FieldValue field) {
+  std::string_view f = field;
+  if (std::any_of(f.begin(), f.end(),
+                  [](char c) { return c == '.' || c == 'e' || c == 'E'; })) {
+    return Numeric(ParseAs<double>(field));
+  } else {
+    return Numeric(ParseAs<int64_t>(field));
+  }
+}
+
+void Numeric::Add(Numeric field) {
+  if (int64_t* current = std::get_if<int64_t>(&v_)) {
+    if (int64_t* that = std::get_if<int64_t>(&field.v_)) {
+      if (!SumOverflows(*current, *that)) {
+        *current += *that;
         return;
       }
-      if (*p == ' ' || *p == '\t') {
-        fields_.emplace_back(std::string_view(begin, p - begin));
-        begin = p + 1;
-        break;
-      }
-      ++p;
     }
+    v_ = static_cast<double>(*current);
   }
+  std::get<double>(v_) += AsDouble(field.v_);
 }
 
+bool Numeric::Min(Numeric field) {
+  if (int64_t* current = std::get_if<int64_t>(&v_)) {
+    if (int64_t* that = std::get_if<int64_t>(&field.v_)) {
+      return UpdateMin(*current, *that);
+    }
+    v_ = static_cast<double>(*current);
+  }
+  return UpdateMin(std::get<double>(v_), AsDouble(field.v_));
+}
+
+bool Numeric::Max(Numeric field) {
+  if (int64_t* current = std::get_if<int64_t>(&v_)) {
+    if (int64_t* that = std::get_if<int64_t>(&field.v_)) {
+      return UpdateMax(*current, *that);
+    }
+    v_ = static_cast<double>(*current);
+  }
+  return UpdateMax(std::get<double>(v_), AsDouble(field.v_));
+}
+
+void Numeric::Print(std::string* out) const {
+  struct {
+    void operator()(int64_t v) { absl::StrAppend(out, v); }
+    void operator()(double v) { absl::StrAppendFormat(out, "%.8g", v); }
+    std::string* out;
+  } p{out};
+  std::visit(p, v_);
+}
+
+double Numeric::ToDouble() const { return AsDouble(v_); }
+
+bool Numeric::operator<(const Numeric& other) const {
+  const int64_t* a = std::get_if<int64_t>(&v_);
+  const int64_t* b = std::get_if<int64_t>(&other.v_);
+  if (a && b) return *a < *b;
+  return AsDouble(v_) < AsDouble(other.v_);
+}
+
+void Numeric::Save(std::string* out) const {
+  char tag = v_.index();
+  out->push_back(tag);
+  std::visit(
+      [out](auto v) {
+        out->append(reinterpret_cast<const char*>(&v), sizeof(v));
+      },
+      v_);
+}
+
+Numeric Numeric::Load(const char*& p) {
+  char tag = *p++;
+  if (tag == 0) {
+    int64_t v;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return Numeric(v);
+  } else {
+    double v;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return Numeric(v);
+  }
+}
+
+void InputRow::Reset(std::span<const std::string_view> columns,
+                     std::span<const Numeric> numbers,
+                     std::span<const char> is_number) {
+  line_ = std::string_view();
+  key_hash_.reset();
+  size_t n = std::min<size_t>(columns.size(), max_field_);
+  fields_.assign(columns.begin(), columns.begin() + n);
+  numbers_.assign(numbers.begin(), numbers.begin() + n);
+  is_number_.assign(is_number.begin(), is_number.begin() + n);
+  // Sized in advance, as fields_ may refer to the strings.
+  if (number_text_.size() < n) number_text_.resize(n);
+}
+
+void InputRow::FormatNumber(int i) const {
+  number_text_[i].clear();
+  numbers_[i].Print(&number_text_[i]);
+  fields_[i] = number_text_[i];
+  is_number_[i] = kFormattedNumber;
+}
+
+void InputRow::SplitLine() const { SplitFields(line_, max_field_, &fields_); }
+
 void InputRow::BuildLine() const {
   line_buf_.clear();
-  for (std::string_view c : fields_) {
-    line_buf_.append(c);
+  for (int i = 0; i < fields_.size(); ++i) {
+    if (!is_number_.empty() && is_number_[i] == kNumber) FormatNumber(i);
+    line_buf_.append(fields_[i]);
     line_buf_.push_back('\t');
   }
   line_ = std::string_view(line_buf_.data(), line_buf_.size() - 1);
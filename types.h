@@ -1,8 +1,13 @@
 #ifndef GITHUB_ZISZIS_ZG_TYPES_INCLUDED
 #define GITHUB_ZISZIS_ZG_TYPES_INCLUDED
 
+#include <algorithm>
+#include <limits>
 #include <optional>
+#include <span>
+#include <string>
 #include <string_view>
+#include <variant>
 #include <vector>
 
 #include "base.h"
@@ -27,35 +32,109 @@ T ParseAs(const FieldValue&);
 template <class T, std::enable_if_t<is_one_of<T, int64_t>(), int> = 0>
 std::optional<T> TryParseAs(const FieldValue&);
 
+class Numeric {
+ public:
+  Numeric() : v_(int64_t{0}) {}
+  explicit Numeric(int64_t v) : v_(v) {}
+  explicit Numeric(double v) : v_(v) {}
+  static Numeric Make(FieldValue);
+
+  void Add(Numeric);
+  bool Min(Numeric);
+  bool Max(Numeric);
+  void Print(std::string*) const;
+  double ToDouble() const;
+  // Integers compare exactly, anything else as doubles.
+  bool operator<(const Numeric& other) const;
+
+  // Binary serialization for spilling to disk. Load() advances `p` past the
+  // value.
+  void Save(std::string* out) const;
+  static Numeric Load(const char*& p);
+
+ private:
+  std::variant<int64_t, double> v_;
+};
+
 class InputRow {
  public:
+  static constexpr int kAllFields = std::numeric_limits<int>::max();
+  // Pseudo-field holding the name of the file the line comes from (see
+  // SetFile()).
+  static constexpr int kFileField = -1;
+
+  // Only fields up to `max_field` are going to be accessed, so the line
+  // doesn't need to be split any further.
+  explicit InputRow(int max_field = kAllFields) : max_field_(max_field) {}
+
   inline void Reset(std::string_view line) {
     line_ = line;
     fields_.clear();
+    is_number_.clear();
+    key_hash_.reset();
   }
 
-  void Reset(const std::vector<std::string_view>& columns) {
-    fields_.clear();
-    line_ = std::string_view();
-    for (auto c : columns) fields_.push_back(FieldValue(c));
-  }
+  // Name of the input file of lines to come, kept across Reset().
+  void SetFile(std::string_view file) { file_ = file; }
+
+  // Hash of the row's key, if it was computed before the row got to its
+  // table (see partitioned.h): HashedKey::Hash() of the key field, or of all
+  // key fields serialized as BaseCompositeKeyTable does. Cleared by Reset().
+  void SetKeyHash(size_t hash) { key_hash_ = hash; }
+  std::optional<size_t> key_hash() const { return key_hash_; }
+
+  // Columns of the previous stage, where those with `is_number` set came as
+  // `numbers` rather than text (see OutputTable::SetNumber()). Numbers are
+  // only formatted if they're read as text.
+  void Reset(std::span<const std::string_view> columns,
+             std::span<const Numeric> numbers,
+             std::span<const char> is_number);
 
   FieldValue operator[](int i) const {
-    if (i == 0) {
+    if (i <= 0) {
+      if (i == kFileField) return FieldValue(file_);
       if (line_.data() == nullptr) BuildLine();
       return FieldValue(line_);
     }
     if (fields_.empty()) SplitLine();
-    return fields_[i - 1];
+    // Fields missing from short lines read as empty.
+    if (static_cast<size_t>(i) > fields_.size()) {
+      return FieldValue(std::string_view());
+    }
+    if (!is_number_.empty() && is_number_[i - 1] == kNumber) {
+      FormatNumber(i - 1);
+    }
+    return FieldValue(fields_[i - 1]);
+  }
+
+  // Same as Numeric::Make((*this)[i]), but numbers passed as such are taken
+  // as they are.
+  Numeric Number(int i) const {
+    if (i > 0 && static_cast<size_t>(i) <= is_number_.size() &&
+        is_number_[i - 1] != kText) {
+      return numbers_[i - 1];
+    }
+    return Numeric::Make((*this)[i]);
   }
 
  private:
+  // Values of is_number_.
+  enum : char { kText = 0, kNumber, kFormattedNumber };
+
   void SplitLine() const;
   void BuildLine() const;
+  void FormatNumber(int i) const;
 
+  int max_field_;
   mutable std::string_view line_;
-  mutable std::vector<FieldValue> fields_;
+  std::string_view file_;
+  std::optional<size_t> key_hash_;
+  mutable std::vector<std::string_view> fields_;
   mutable std::string line_buf_;
+  // Set by the second Reset() only, empty otherwise.
+  std::vector<Numeric> numbers_;
+  mutable std::vector<char> is_number_;
+  mutable std::vector<std::string> number_text_;
 };
 
 #endif  // GITHUB_ZISZIS_ZG_TYPES_INCLUDED
@@ -1,28 +1,29 @@
 #include <memory>
 #include <string>
 
-#include "base.h"
-#include "input.h"
+#include "options.h"
+#include "parallel.h"
 #include "pipeline.h"
 #include "spec-parser.h"
 #include "spec.h"
-#include "types.h"
 
 int main(int argc, char* argv[]) {
+  Options options;
   std::string spec_str;
-  for (int i = 1; i < argc; ++i) {
-    if (i != 1) spec_str.push_back(' ');
-    spec_str.append(argv[i]);
+  for (const std::string& arg : ParseOptions(argc, argv, &options)) {
+    if (!spec_str.empty()) spec_str.push_back(' ');
+    spec_str.append(arg);
   }
   spec::Pipeline spec = spec::Parse(spec_str);
 
-  std::unique_ptr<Table> table = BuildPipeline(spec);
+  int max_field;
+  std::unique_ptr<Table> table = BuildPipeline(spec, options, &max_field);
 
-  InputRow row;
-  ForEachInputLine([&](const char* begin, const char* end) {
-    row.Reset(std::string_view(begin, end - begin));
-    table->PushRow(row);
-  });
+  if (options.inputs.empty()) {
+    PushInputInParallel(options.threads, 0, max_field, *table);
+  } else {
+    PushFilesInParallel(options.threads, options.inputs, max_field, *table);
+  }
   table->Finish();
 
   return 0;